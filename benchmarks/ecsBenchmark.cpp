@@ -0,0 +1,225 @@
+// Measures the basic ECS operations for both storage layouts: entity
+// creation, component assignment, single- and multi-component iteration,
+// random access, deletion and prefab instantiation (sparse set only).
+// Nothing here touches a window or Vulkan.
+//
+// Usage: ecs_benchmark [--json <file>] [--count <entities>]
+// Without --json a table is printed, with it the results are also written as
+// a JSON array of {"storage", "operation", "entities", "nsPerEntity"}.
+// --count runs a single entity count instead of the default sweep, e.g. a
+// small one for a quick smoke run.
+
+#include "../src/triangleArchetype.hpp"
+#include "../src/triangleECS.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+    using namespace triangle;
+
+    struct Position
+    {
+        float x = 0.f, y = 0.f, z = 0.f;
+    };
+
+    struct Velocity
+    {
+        float x = 0.f, y = 0.f, z = 0.f;
+    };
+
+    struct Health
+    {
+        int32_t value = 100;
+    };
+
+    struct Result
+    {
+        std::string storage;
+        std::string operation;
+        uint32_t entities;
+        double nsPerEntity;
+    };
+
+    using Clock = std::chrono::steady_clock;
+
+    double nanoseconds(Clock::time_point start)
+    {
+        return std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    }
+
+    // Repeats a non-destructive pass until minSeconds have passed
+    template <typename Func>
+    double measureRepeated(uint32_t count, Func&& func, double minSeconds = 0.1)
+    {
+        func();
+
+        uint32_t iterations = 0;
+        auto start = Clock::now();
+        double elapsed = 0.0;
+        do
+        {
+            func();
+            ++iterations;
+            elapsed = nanoseconds(start);
+        } while (elapsed < minSeconds * 1.0e9);
+
+        return elapsed / (double(iterations) * count);
+    }
+
+    // Keeps the optimizer from dropping the iteration passes
+    volatile float g_Sink = 0.f;
+
+    template <typename World>
+    void run(const char* storage, uint32_t count, std::vector<Result>& results)
+    {
+        auto record = [&](const char* operation, double nsPerEntity)
+        {
+            results.push_back(Result{storage, operation, count, nsPerEntity});
+        };
+
+        std::mt19937 random{1234};
+        World world;
+        std::vector<Entity> entities;
+        entities.reserve(count);
+
+        auto start = Clock::now();
+        for (uint32_t i = 0; i < count; ++i)
+            entities.push_back(world.addEntity());
+        record("create", nanoseconds(start) / count);
+
+        start = Clock::now();
+        for (uint32_t i = 0; i < count; ++i)
+            world.assignComponent(entities[i], Position{float(i), 0.f, 0.f});
+        record("assign", nanoseconds(start) / count);
+
+        // Half of the entities move, every fourth one has health
+        for (uint32_t i = 0; i < count; i += 2)
+            world.assignComponent(entities[i], Velocity{1.f, 2.f, 3.f});
+        for (uint32_t i = 0; i < count; i += 4)
+            world.assignComponent(entities[i], Health{});
+
+        record("iterate 1 component", measureRepeated(count, [&]
+        {
+            float sum = 0.f;
+            world.template view<Position>().each([&](Entity, Position& position) { sum += position.x; });
+            g_Sink = sum;
+        }));
+
+        record("iterate 2 components", measureRepeated(count, [&]
+        {
+            world.template view<Position, Velocity>().each([&](Entity, Position& position, Velocity& velocity)
+            {
+                position.x += velocity.x;
+                position.y += velocity.y;
+                position.z += velocity.z;
+            });
+        }));
+
+        record("iterate 3 components", measureRepeated(count, [&]
+        {
+            float sum = 0.f;
+            world.template view<Position, Velocity, Health>().each([&](Entity, Position& position, Velocity& velocity, Health& health)
+            {
+                sum += position.x * velocity.x + float(health.value);
+            });
+            g_Sink = sum;
+        }));
+
+        std::vector<Entity> shuffled = entities;
+        std::shuffle(shuffled.begin(), shuffled.end(), random);
+
+        record("random access", measureRepeated(count, [&]
+        {
+            float sum = 0.f;
+            for (const Entity& entity : shuffled)
+                sum += world.template getComponent<Position>(entity)->x;
+            g_Sink = sum;
+        }));
+
+        start = Clock::now();
+        for (uint32_t i = 0; i < count; i += 2)
+            world.template deleteComponent<Velocity>(entities[i]);
+        record("remove component", nanoseconds(start) / ((count + 1) / 2));
+
+        start = Clock::now();
+        for (Entity& entity : shuffled)
+            world.deleteEntity(entity);
+        record("delete", nanoseconds(start) / count);
+
+        // Same components as above, spawned in one call
+        if constexpr (requires(World& w, const Prefab<Position, Velocity>& p) { w.instantiate(p, 0u); })
+        {
+            World prefabWorld;
+            Prefab<Position, Velocity> prefab(Position{}, Velocity{1.f, 2.f, 3.f});
+
+            start = Clock::now();
+            auto spawned = prefabWorld.instantiate(prefab, count);
+            record("instantiate prefab", nanoseconds(start) / count);
+        }
+    }
+
+    void writeJson(const char* path, const std::vector<Result>& results)
+    {
+        FILE* file = std::fopen(path, "w");
+        if (!file)
+        {
+            std::fprintf(stderr, "could not open %s\n", path);
+            return;
+        }
+
+        std::fprintf(file, "[\n");
+        for (size_t i = 0; i < results.size(); ++i)
+        {
+            const Result& result = results[i];
+            std::fprintf(file, "  {\"storage\": \"%s\", \"operation\": \"%s\", \"entities\": %u, \"nsPerEntity\": %.3f}%s\n",
+                         result.storage.c_str(), result.operation.c_str(), result.entities, result.nsPerEntity,
+                         i + 1 < results.size() ? "," : "");
+        }
+        std::fprintf(file, "]\n");
+
+        std::fclose(file);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const char* jsonPath = nullptr;
+    std::vector<uint32_t> counts = {1000u, 100000u, 1000000u};
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "--json") == 0 && i + 1 < argc)
+            jsonPath = argv[++i];
+        else if (std::strcmp(argv[i], "--count") == 0 && i + 1 < argc && std::strtoul(argv[i + 1], nullptr, 10) > 0)
+            counts = {static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10))};
+        else
+        {
+            std::fprintf(stderr, "usage: %s [--json <file>] [--count <entities>]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    std::vector<Result> results;
+    for (uint32_t count : counts)
+    {
+        run<ECS<Position, Velocity, Health>>("sparse set", count, results);
+        run<ArchetypeECS<Position, Velocity, Health>>("archetype", count, results);
+    }
+
+    std::printf("%-12s %-22s %10s %12s\n", "storage", "operation", "entities", "ns/entity");
+    for (const Result& result : results)
+        std::printf("%-12s %-22s %10u %12.2f\n", result.storage.c_str(), result.operation.c_str(), result.entities, result.nsPerEntity);
+
+    if (jsonPath)
+        writeJson(jsonPath, results);
+
+    return 0;
+}
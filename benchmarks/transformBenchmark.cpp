@@ -0,0 +1,114 @@
+// Compares the batch transform kernels with the per-entity glm path used
+// by the engine before them: translate/rotate/scale per entity, followed by
+// proj * view * model.
+
+#include "../src/triangleTransformKernels.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+namespace
+{
+    using namespace triangle;
+
+    // Runs func until at least minSeconds have passed, returns ns per entity
+    template <typename Func>
+    double measure(uint32_t count, Func&& func, double minSeconds = 0.1)
+    {
+        using Clock = std::chrono::steady_clock;
+
+        func();
+
+        uint32_t iterations = 0;
+        auto start = Clock::now();
+        std::chrono::duration<double> elapsed{0.0};
+        do
+        {
+            func();
+            ++iterations;
+            elapsed = Clock::now() - start;
+        } while (elapsed.count() < minSeconds);
+
+        return elapsed.count() * 1.0e9 / (double(iterations) * count);
+    }
+
+    // Keeps the optimizer from dropping the results
+    float checksum(const std::vector<glm::mat4>& matrices)
+    {
+        float sum = 0.f;
+        for (const auto& matrix : matrices)
+            sum += matrix[3][0] + matrix[0][0];
+        return sum;
+    }
+}
+
+int main()
+{
+    std::mt19937 random{42};
+    std::uniform_real_distribution<float> distribution{-1.f, 1.f};
+
+    glm::mat4 view = glm::lookAt(glm::vec3(0.f, 0.f, 10.f), glm::vec3(0.f), glm::vec3(0.f, 1.f, 0.f));
+    glm::mat4 proj = glm::perspective(glm::radians(45.0f), 16.f / 9.f, 0.1f, 20.0f);
+    glm::mat4 viewProj = proj * view;
+
+    std::printf("CPU supports: %s\n", getSimdLevelName(getSimdLevel()));
+    std::printf("%10s %-16s %12s %10s\n", "entities", "path", "ns/entity", "speedup");
+
+    float sink = 0.f;
+    for (uint32_t count : {1000u, 10000u, 100000u})
+    {
+        std::vector<Transform> transforms(count);
+        for (auto& transform : transforms)
+        {
+            transform.position = glm::vec3(distribution(random), distribution(random), distribution(random)) * 10.f;
+            transform.rotation = glm::vec3(distribution(random), distribution(random), distribution(random)) * glm::pi<float>();
+            transform.scale = glm::vec3(1.f) + glm::vec3(distribution(random), distribution(random), distribution(random)) * 0.5f;
+        }
+
+        std::vector<glm::mat4> models(count), mvps(count);
+
+        double glmTime = measure(count, [&]
+        {
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                models[i] = transforms[i].getMatrix();
+                mvps[i] = proj * view * models[i];
+            }
+        });
+        sink += checksum(mvps);
+        std::printf("%10u %-16s %12.2f %10s\n", count, "glm per entity", glmTime, "1.00x");
+
+        TransformSoA batch;
+        double gatherTime = measure(count, [&]
+        {
+            batch.clear();
+            for (const auto& transform : transforms)
+                batch.push_back(transform);
+        });
+        std::printf("%10u %-16s %12.2f %10s\n", count, "SoA gather", gatherTime, "-");
+
+        for (SimdLevel level : {SimdLevel::Scalar, SimdLevel::SSE41, SimdLevel::AVX2})
+        {
+            if (level > getSimdLevel())
+                continue;
+
+            double time = measure(count, [&]
+            {
+                composeMVPMatrices(batch, viewProj, 0, count, models.data(), mvps.data(), level);
+            });
+            sink += checksum(mvps);
+
+            char name[32];
+            std::snprintf(name, sizeof(name), "batch %s", getSimdLevelName(level));
+            std::printf("%10u %-16s %12.2f %9.2fx\n", count, name, time, glmTime / time);
+        }
+    }
+
+    std::printf("(checksum %g)\n", sink);
+
+    return 0;
+}
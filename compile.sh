@@ -1,6 +1,15 @@
+set -e
 echo "Compiling shaders..."
+mkdir -p shaders/spv
 glslc shaders/defaultShader.vert -o shaders/spv/defaultVert.spv
 glslc shaders/defaultShader.frag -o shaders/spv/defaultFrag.spv
 glslc shaders/texturedShader.vert -o shaders/spv/texturedVert.spv
 glslc shaders/texturedShader.frag -o shaders/spv/texturedFrag.spv
+glslc shaders/cullShader.comp -o shaders/spv/cullComp.spv
+echo "Validating shaders..."
+spirv-val --target-env vulkan1.0 shaders/spv/defaultVert.spv
+spirv-val --target-env vulkan1.0 shaders/spv/defaultFrag.spv
+spirv-val --target-env vulkan1.0 shaders/spv/texturedVert.spv
+spirv-val --target-env vulkan1.0 shaders/spv/texturedFrag.spv
+spirv-val --target-env vulkan1.0 shaders/spv/cullComp.spv
 echo "Done compiling."
\ No newline at end of file
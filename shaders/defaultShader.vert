@@ -8,14 +8,25 @@ layout (location = 2) in vec2 inUV;
 
 layout (location = 0) out vec3 fragColor;
 
-layout (binding = 0) uniform UniformBufferObject
+layout (binding = 0) uniform CameraBuffer
 {
-    mat4 model;
     mat4 view;
     mat4 proj;
-} ubo;
+    mat4 viewProj;
+} camera;
+
+layout (std430, binding = 2) readonly buffer ObjectBuffer
+{
+    mat4 models[];
+} objects;
+
+// Object slot of each drawn instance
+layout (std430, binding = 3) readonly buffer InstanceBuffer
+{
+    uint slots[];
+} instances;
 
 void main() {
-    gl_Position = ubo.proj * ubo.view * ubo.model * vec4(inPosition, 1.0f);
+    gl_Position = camera.viewProj * objects.models[instances.slots[gl_InstanceIndex]] * vec4(inPosition, 1.0f);
     fragColor = inColor;
 }
\ No newline at end of file
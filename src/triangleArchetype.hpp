@@ -0,0 +1,440 @@
+#pragma once
+
+#include "triangleECS.hpp"
+
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+namespace triangle
+{
+	// Type-erased operations needed to move components between archetypes
+	struct ComponentInfo
+	{
+		ComponentID id;
+		size_t size;
+		size_t alignment;
+		void (*moveConstruct)(void* a_Dst, void* a_Src);
+		void (*destroy)(void* a_Component);
+	};
+
+	template <typename T>
+	constexpr ComponentInfo makeComponentInfo(ComponentID a_ID)
+	{
+		return ComponentInfo{
+			a_ID,
+			sizeof(T),
+			alignof(T),
+			[](void* a_Dst, void* a_Src) { std::construct_at(static_cast<T*>(a_Dst), std::move(*static_cast<T*>(a_Src))); },
+			[](void* a_Component) { std::destroy_at(static_cast<T*>(a_Component)); }};
+	}
+
+	// Fixed-size block holding a run of rows of one archetype, one column
+	// (SoA array) per component plus the owning entity handles.
+	struct alignas(64) ArchetypeChunk
+	{
+		static constexpr size_t size = 16 * 1024;
+
+		std::byte data[size];
+	};
+
+	// Every entity with the same component signature lives in the same
+	// archetype. Rows are packed: chunks are full except the last one.
+	class Archetype
+	{
+	public:
+		Archetype(const Signature& a_Signature, std::vector<const ComponentInfo*> a_Components)
+			: m_Signature{a_Signature}, m_Components{std::move(a_Components)}
+		{
+			m_Columns.fill(npos);
+			for (uint32_t i = 0; i < m_Components.size(); ++i)
+				m_Columns[m_Components[i]->id] = i;
+
+			size_t rowSize = sizeof(Entity);
+			for (auto* component : m_Components)
+				rowSize += component->size;
+
+			m_ChunkCapacity = static_cast<uint32_t>(ArchetypeChunk::size / rowSize);
+			while (m_ChunkCapacity > 0 && !layoutColumns())
+				--m_ChunkCapacity;
+
+			// Row indices are split with / and % by the capacity
+			if (m_ChunkCapacity == 0)
+				throw std::length_error("archetype row does not fit in a chunk");
+		}
+
+		~Archetype()
+		{
+			for (uint32_t row = 0; row < m_Size; ++row)
+				for (uint32_t column = 0; column < m_Components.size(); ++column)
+					m_Components[column]->destroy(getColumnElement(column, row));
+		}
+
+		const Signature& getSignature() const { return m_Signature; }
+		const std::vector<const ComponentInfo*>& getComponents() const { return m_Components; }
+		uint32_t getColumn(ComponentID a_ComponentID) const { return m_Columns[a_ComponentID]; }
+
+		uint32_t size() const { return m_Size; }
+		uint32_t getChunkCount() const { return static_cast<uint32_t>(m_Chunks.size()); }
+		uint32_t getChunkSize(uint32_t a_Chunk) const
+		{
+			return a_Chunk + 1 < m_Chunks.size() ? m_ChunkCapacity : m_Size - a_Chunk * m_ChunkCapacity;
+		}
+
+		Entity* getEntities(uint32_t a_Chunk)
+		{
+			return reinterpret_cast<Entity*>(m_Chunks[a_Chunk]->data);
+		}
+
+		template <typename T>
+		T* getColumnData(uint32_t a_Chunk, uint32_t a_Column)
+		{
+			return std::launder(reinterpret_cast<T*>(m_Chunks[a_Chunk]->data + m_ColumnOffsets[a_Column]));
+		}
+
+		void* getColumnElement(uint32_t a_Column, uint32_t a_Row)
+		{
+			auto& chunk = m_Chunks[a_Row / m_ChunkCapacity];
+			return chunk->data + m_ColumnOffsets[a_Column] + (a_Row % m_ChunkCapacity) * m_Components[a_Column]->size;
+		}
+
+		Entity& getEntity(uint32_t a_Row)
+		{
+			return getEntities(a_Row / m_ChunkCapacity)[a_Row % m_ChunkCapacity];
+		}
+
+		// Component storage of the new row is left uninitialized
+		uint32_t pushRow(const Entity& a_Entity)
+		{
+			if (m_Size == m_Chunks.size() * m_ChunkCapacity)
+				m_Chunks.push_back(std::make_unique<ArchetypeChunk>());
+
+			uint32_t row = m_Size++;
+			std::construct_at(&getEntity(row), a_Entity);
+
+			return row;
+		}
+
+		// Fills the hole with the last row, returns the entity that moved into
+		// a_Row (null if a_Row was the last row). Components of a_Row must have
+		// been destroyed or moved out already.
+		Entity popRow(uint32_t a_Row)
+		{
+			uint32_t last = --m_Size;
+			Entity moved{};
+
+			if (a_Row != last)
+			{
+				for (uint32_t column = 0; column < m_Components.size(); ++column)
+				{
+					void* src = getColumnElement(column, last);
+					m_Components[column]->moveConstruct(getColumnElement(column, a_Row), src);
+					m_Components[column]->destroy(src);
+				}
+
+				moved = getEntity(last);
+				getEntity(a_Row) = moved;
+			}
+
+			if (m_Size <= (m_Chunks.size() - 1) * m_ChunkCapacity)
+				m_Chunks.pop_back();
+
+			return moved;
+		}
+
+		Archetype*& getAddEdge(ComponentID a_ComponentID) { return m_AddEdges[a_ComponentID]; }
+		Archetype*& getRemoveEdge(ComponentID a_ComponentID) { return m_RemoveEdges[a_ComponentID]; }
+
+	private:
+		Signature m_Signature;
+		std::vector<const ComponentInfo*> m_Components;
+		std::array<uint32_t, maxComponents> m_Columns;
+		std::vector<size_t> m_ColumnOffsets;
+
+		uint32_t m_ChunkCapacity = 0;
+		uint32_t m_Size = 0;
+		std::vector<std::unique_ptr<ArchetypeChunk>> m_Chunks;
+
+		// Cached transitions to the archetype with one component added/removed
+		std::array<Archetype*, maxComponents> m_AddEdges{};
+		std::array<Archetype*, maxComponents> m_RemoveEdges{};
+
+		bool layoutColumns()
+		{
+			m_ColumnOffsets.clear();
+			size_t offset = sizeof(Entity) * m_ChunkCapacity;
+
+			for (auto* component : m_Components)
+			{
+				offset = (offset + component->alignment - 1) & ~(component->alignment - 1);
+				m_ColumnOffsets.push_back(offset);
+				offset += component->size * m_ChunkCapacity;
+			}
+
+			return offset <= ArchetypeChunk::size;
+		}
+	};
+
+	// Iterates the chunks of every archetype whose signature contains Ts
+	template <typename... Ts>
+	class ArchetypeView
+	{
+	public:
+		struct Match
+		{
+			Archetype* archetype;
+			std::array<uint32_t, sizeof...(Ts)> columns;
+		};
+
+		ArchetypeView(std::vector<Match> a_Matches) : m_Matches{std::move(a_Matches)} {}
+
+		size_t size() const
+		{
+			size_t count = 0;
+			for (auto& match : m_Matches)
+				count += match.archetype->size();
+
+			return count;
+		}
+
+		template <typename Func>
+		void each(Func&& a_Func)
+		{
+			for (auto& match : m_Matches)
+				eachChunk(match, a_Func, std::index_sequence_for<Ts...>{});
+		}
+
+	private:
+		std::vector<Match> m_Matches;
+
+		template <typename Func, size_t... Is>
+		void eachChunk(Match& a_Match, Func& a_Func, std::index_sequence<Is...>)
+		{
+			Archetype* archetype = a_Match.archetype;
+			for (uint32_t chunk = 0; chunk < archetype->getChunkCount(); ++chunk)
+			{
+				uint32_t count = archetype->getChunkSize(chunk);
+				Entity* entities = archetype->getEntities(chunk);
+				std::tuple<Ts*...> columns{archetype->getColumnData<Ts>(chunk, a_Match.columns[Is])...};
+
+				for (uint32_t i = 0; i < count; ++i)
+					a_Func(entities[i], std::get<Is>(columns)[i]...);
+			}
+		}
+	};
+
+	// Same interface as ECS, but stores components grouped by signature in
+	// chunked SoA tables. Adding or removing a component moves the entity
+	// to another archetype, so it favours stable entity layouts and
+	// multi-component queries over frequent component churn.
+	template <typename... Components>
+	class ArchetypeECS
+	{
+	public:
+		using Registry = ComponentRegistry<Components...>;
+
+		template <typename T>
+		static constexpr ComponentID componentID()
+		{
+			static_assert(Registry::template contains<T>(), "component type is not registered with this ECS");
+			return Registry::template id<T>();
+		}
+
+		template <typename... Ts>
+		static constexpr Signature signature() { return Registry::template signature<Ts...>(); }
+
+		// Every archetype row, including alignment padding, has to fit in one
+		// chunk. The row of all components bounds every other archetype's.
+		static_assert(sizeof(Entity) + ((sizeof(Components) + alignof(Components)) + ... + 0) <= ArchetypeChunk::size,
+					  "component set does not fit in an archetype chunk");
+
+		ArchetypeECS() { m_EmptyArchetype = getArchetype(Signature{}, {}); }
+
+		// Archetypes point into m_ComponentInfos, which would be left behind
+		ArchetypeECS(const ArchetypeECS&) = delete;
+		ArchetypeECS& operator=(const ArchetypeECS&) = delete;
+		ArchetypeECS(ArchetypeECS&&) = delete;
+		ArchetypeECS& operator=(ArchetypeECS&&) = delete;
+
+		const std::vector<Entity>& getEntities() const { return m_Allocator.getEntities(); }
+		// Live entities only, ids of deleted entities stay reserved
+		uint32_t getLiveEntityCount() const { return static_cast<uint32_t>(getEntities().size()); }
+		bool isAlive(const Entity& a_Entity) const { return m_Allocator.isAlive(a_Entity); }
+
+		Entity addEntity()
+		{
+			Entity entity = m_Allocator.create();
+			if (entity.id >= m_Locations.size())
+				m_Locations.resize(entity.id + 1);
+
+			m_Locations[entity.id] = {m_EmptyArchetype, m_EmptyArchetype->pushRow(entity)};
+
+			return entity;
+		}
+
+		bool deleteEntity(Entity& a_Entity)
+		{
+			if (!isAlive(a_Entity))
+				return false;
+
+			auto [archetype, row] = m_Locations[a_Entity.id];
+			for (uint32_t column = 0; column < archetype->getComponents().size(); ++column)
+				archetype->getComponents()[column]->destroy(archetype->getColumnElement(column, row));
+
+			removeRow(archetype, row);
+
+			m_Allocator.destroy(a_Entity);
+			a_Entity = Entity{};
+
+			return true;
+		}
+
+		template <typename T>
+		bool assignComponent(const Entity& a_Entity, const T& a_Component)
+		{
+			if (!isAlive(a_Entity))
+				return false;
+
+			const ComponentInfo& info = m_ComponentInfos[componentID<T>()];
+			auto [source, row] = m_Locations[a_Entity.id];
+
+			// Keeps the existing component if the entity already has one
+			if (source->getSignature().test(info.id))
+				return true;
+
+			Archetype*& edge = source->getAddEdge(info.id);
+			if (edge == nullptr)
+			{
+				std::vector<const ComponentInfo*> components = source->getComponents();
+				components.push_back(&info);
+				std::sort(components.begin(), components.end(), [](auto* a, auto* b) { return a->id < b->id; });
+
+				edge = getArchetype(Signature{source->getSignature()}.set(info.id), std::move(components));
+			}
+
+			uint32_t newRow = moveEntity(a_Entity, source, row, edge);
+			std::construct_at(static_cast<T*>(edge->getColumnElement(edge->getColumn(info.id), newRow)), a_Component);
+
+			return true;
+		}
+
+		template <typename T>
+		T* getComponent(const Entity& a_Entity)
+		{
+			if (!isAlive(a_Entity))
+				return nullptr;
+
+			auto [archetype, row] = m_Locations[a_Entity.id];
+			uint32_t column = archetype->getColumn(componentID<T>());
+			if (column == npos)
+				return nullptr;
+
+			return std::launder(static_cast<T*>(archetype->getColumnElement(column, row)));
+		}
+
+		template <typename T>
+		bool deleteComponent(const Entity& a_Entity)
+		{
+			if (!isAlive(a_Entity))
+				return false;
+
+			ComponentID id = componentID<T>();
+			auto [source, row] = m_Locations[a_Entity.id];
+			uint32_t column = source->getColumn(id);
+			if (column == npos)
+				return true;
+
+			Archetype*& edge = source->getRemoveEdge(id);
+			if (edge == nullptr)
+			{
+				std::vector<const ComponentInfo*> components = source->getComponents();
+				components.erase(components.begin() + column);
+
+				edge = getArchetype(Signature{source->getSignature()}.reset(id), std::move(components));
+			}
+
+			source->getComponents()[column]->destroy(source->getColumnElement(column, row));
+			moveEntity(a_Entity, source, row, edge);
+
+			return true;
+		}
+
+		template <typename... Ts>
+		ArchetypeView<Ts...> view()
+		{
+			constexpr Signature mask = signature<Ts...>();
+
+			std::vector<typename ArchetypeView<Ts...>::Match> matches;
+			for (auto& archetype : m_Archetypes)
+			{
+				if (archetype->size() != 0 && (archetype->getSignature() & mask) == mask)
+					matches.push_back({archetype.get(), {archetype->getColumn(componentID<Ts>())...}});
+			}
+
+			return ArchetypeView<Ts...>(std::move(matches));
+		}
+
+	private:
+		struct EntityLocation
+		{
+			Archetype* archetype = nullptr;
+			uint32_t row = 0;
+		};
+
+		const std::array<ComponentInfo, sizeof...(Components)> m_ComponentInfos{
+			makeComponentInfo<Components>(componentID<Components>())...};
+
+		EntityAllocator m_Allocator;
+		std::vector<EntityLocation> m_Locations;
+
+		std::vector<std::unique_ptr<Archetype>> m_Archetypes;
+		std::unordered_map<Signature, Archetype*> m_ArchetypeIndex;
+		Archetype* m_EmptyArchetype = nullptr;
+
+		Archetype* getArchetype(const Signature& a_Signature, std::vector<const ComponentInfo*> a_Components)
+		{
+			auto search = m_ArchetypeIndex.find(a_Signature);
+			if (search != m_ArchetypeIndex.end())
+				return search->second;
+
+			m_Archetypes.push_back(std::make_unique<Archetype>(a_Signature, std::move(a_Components)));
+			m_ArchetypeIndex.insert({a_Signature, m_Archetypes.back().get()});
+
+			return m_Archetypes.back().get();
+		}
+
+		void removeRow(Archetype* a_Archetype, uint32_t a_Row)
+		{
+			Entity moved = a_Archetype->popRow(a_Row);
+			if (moved.id != 0)
+				m_Locations[moved.id].row = a_Row;
+		}
+
+		// Moves every component the destination shares with the source.
+		// Components only present in the source must already be destroyed.
+		uint32_t moveEntity(const Entity& a_Entity, Archetype* a_Source, uint32_t a_Row, Archetype* a_Destination)
+		{
+			uint32_t newRow = a_Destination->pushRow(a_Entity);
+
+			for (uint32_t column = 0; column < a_Source->getComponents().size(); ++column)
+			{
+				uint32_t destColumn = a_Destination->getColumn(a_Source->getComponents()[column]->id);
+				if (destColumn == npos)
+					continue;
+
+				void* src = a_Source->getColumnElement(column, a_Row);
+				a_Source->getComponents()[column]->moveConstruct(a_Destination->getColumnElement(destColumn, newRow), src);
+				a_Source->getComponents()[column]->destroy(src);
+			}
+
+			removeRow(a_Source, a_Row);
+			m_Locations[a_Entity.id] = {a_Destination, newRow};
+
+			return newRow;
+		}
+	};
+}
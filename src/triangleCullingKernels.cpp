@@ -0,0 +1,100 @@
+#include "triangleCullingKernels.hpp"
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+    #define TRIANGLE_X86_SIMD 1
+    #include <immintrin.h>
+#else
+    #define TRIANGLE_X86_SIMD 0
+#endif
+
+namespace triangle
+{
+    namespace
+    {
+        uint32_t cullScalar(const BoundsSoA& b, const Frustum& frustum, uint32_t begin, uint32_t end, uint8_t* visible)
+        {
+            uint32_t count = 0;
+            for (uint32_t i = begin; i < end; ++i)
+            {
+                bool inside = frustum.intersectsSphere(glm::vec3(b.centerX[i], b.centerY[i], b.centerZ[i]), b.radius[i]);
+                visible[i] = inside;
+                count += inside;
+            }
+            return count;
+        }
+
+#if TRIANGLE_X86_SIMD
+        // One plane per step for 4 spheres: distance = n . c + d, the sphere
+        // is outside if distance < -radius
+        __attribute__((target("sse4.1")))
+        uint32_t cullSSE41(const BoundsSoA& b, const Frustum& frustum, uint32_t begin, uint32_t end, uint8_t* visible)
+        {
+            uint32_t count = 0, i = begin;
+            for (; i + 4 <= end; i += 4)
+            {
+                __m128 x = _mm_loadu_ps(&b.centerX[i]), y = _mm_loadu_ps(&b.centerY[i]), z = _mm_loadu_ps(&b.centerZ[i]);
+                __m128 negativeRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&b.radius[i]));
+
+                __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+                for (const auto& plane : frustum.planes)
+                {
+                    __m128 distance = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.x), x), _mm_set1_ps(plane.w));
+                    distance = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.y), y), distance);
+                    distance = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.z), z), distance);
+                    inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negativeRadius));
+                }
+
+                int mask = _mm_movemask_ps(inside);
+                for (uint32_t k = 0; k < 4; ++k)
+                    visible[i + k] = (mask >> k) & 1;
+                count += __builtin_popcount(mask);
+            }
+
+            return count + cullScalar(b, frustum, i, end, visible);
+        }
+
+        __attribute__((target("avx2,fma")))
+        uint32_t cullAVX2(const BoundsSoA& b, const Frustum& frustum, uint32_t begin, uint32_t end, uint8_t* visible)
+        {
+            uint32_t count = 0, i = begin;
+            for (; i + 8 <= end; i += 8)
+            {
+                __m256 x = _mm256_loadu_ps(&b.centerX[i]), y = _mm256_loadu_ps(&b.centerY[i]), z = _mm256_loadu_ps(&b.centerZ[i]);
+                __m256 negativeRadius = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(&b.radius[i]));
+
+                __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+                for (const auto& plane : frustum.planes)
+                {
+                    __m256 distance = _mm256_fmadd_ps(_mm256_set1_ps(plane.x), x, _mm256_set1_ps(plane.w));
+                    distance = _mm256_fmadd_ps(_mm256_set1_ps(plane.y), y, distance);
+                    distance = _mm256_fmadd_ps(_mm256_set1_ps(plane.z), z, distance);
+                    inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, negativeRadius, _CMP_GE_OQ));
+                }
+
+                int mask = _mm256_movemask_ps(inside);
+                for (uint32_t k = 0; k < 8; ++k)
+                    visible[i + k] = (mask >> k) & 1;
+                count += __builtin_popcount(mask);
+            }
+
+            return count + cullSSE41(b, frustum, i, end, visible);
+        }
+#endif
+    }
+
+    uint32_t cullSpheres(const BoundsSoA& bounds, const Frustum& frustum, uint32_t begin, uint32_t end, uint8_t* visible, SimdLevel level)
+    {
+        level = std::min(level, getSimdLevel());
+        end = std::min(end, bounds.size());
+        if (begin >= end)
+            return 0;
+
+#if TRIANGLE_X86_SIMD
+        if (level == SimdLevel::AVX2)
+            return cullAVX2(bounds, frustum, begin, end, visible);
+        if (level == SimdLevel::SSE41)
+            return cullSSE41(bounds, frustum, begin, end, visible);
+#endif
+        return cullScalar(bounds, frustum, begin, end, visible);
+    }
+}
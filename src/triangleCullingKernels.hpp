@@ -0,0 +1,47 @@
+#pragma once
+
+#include "triangleTransformKernels.hpp"
+#include "triangleTypes.hpp"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace triangle
+{
+    // World space bounding spheres, one array per component so the test
+    // below can load several objects per register
+    struct BoundsSoA
+    {
+        std::vector<float> centerX, centerY, centerZ, radius;
+
+        uint32_t size() const { return static_cast<uint32_t>(centerX.size()); }
+
+        void clear()
+        {
+            for (auto* values : {&centerX, &centerY, &centerZ, &radius})
+                values->clear();
+        }
+
+        // Moves a model space sphere (center, radius) into world space. The
+        // radius grows with the largest axis scale of the model matrix.
+        void push_back(const glm::mat4& model, const glm::vec4& sphere)
+        {
+            glm::vec3 center = glm::vec3(model * glm::vec4(glm::vec3(sphere), 1.f));
+            float scale = std::max({glm::length(glm::vec3(model[0])), glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))});
+
+            centerX.push_back(center.x);
+            centerY.push_back(center.y);
+            centerZ.push_back(center.z);
+            radius.push_back(sphere.w * scale);
+        }
+    };
+
+    // visible[i] = 1 if sphere i intersects the frustum, 0 otherwise, for
+    // every i in [begin, end). Returns the number of visible spheres. AVX2
+    // tests 8 spheres per plane and instruction, SSE4.1 tests 4.
+    uint32_t cullSpheres(const BoundsSoA& bounds, const Frustum& frustum, uint32_t begin, uint32_t end,
+                         uint8_t* visible, SimdLevel level = getSimdLevel());
+}
@@ -6,12 +6,14 @@
 
 namespace triangle
 {
-    Descriptor::Descriptor(Device &device, uint32_t descriptorCount, const std::vector<vk::Buffer> &buffers, const Swapchain::Texture &textureProperties)
+    Descriptor::Descriptor(Device &device, uint32_t descriptorCount, const std::vector<vk::Buffer> &buffers,
+                           const std::vector<vk::Buffer> &objectBuffers, const std::vector<vk::Buffer> &instanceBuffers,
+                           const Swapchain::Texture &textureProperties)
         : device{device}, descriptorCount{descriptorCount}
     {
         createDescriptorSetLayout();
         createDescriptorPool();
-        createDescriptorSets(buffers, textureProperties);
+        createDescriptorSets(buffers, objectBuffers, instanceBuffers, textureProperties);
     }
 
     Descriptor::~Descriptor()
@@ -23,8 +25,9 @@ namespace triangle
     void Descriptor::createDescriptorPool()
     {
         std::vector<vk::DescriptorPoolSize> poolSize;
-        poolSize.push_back(vk::DescriptorPoolSize(vk::DescriptorType::eUniformBufferDynamic, descriptorCount));
+        poolSize.push_back(vk::DescriptorPoolSize(vk::DescriptorType::eUniformBuffer, descriptorCount));
         poolSize.push_back(vk::DescriptorPoolSize(vk::DescriptorType::eCombinedImageSampler, descriptorCount));
+        poolSize.push_back(vk::DescriptorPoolSize(vk::DescriptorType::eStorageBuffer, descriptorCount * 2));
 
         vk::DescriptorPoolCreateInfo descriptorPoolCreateInfo(
             vk::DescriptorPoolCreateFlags(),
@@ -41,15 +44,25 @@ namespace triangle
         descSetLayoutBindings.reserve(descriptorCount);
 
         vk::DescriptorSetLayoutBinding cameraLayoutBinding = vk::DescriptorSetLayoutBinding(
-            0, vk::DescriptorType::eUniformBufferDynamic, 1, vk::ShaderStageFlagBits::eVertex, nullptr
+            0, vk::DescriptorType::eUniformBuffer, 1, vk::ShaderStageFlagBits::eVertex, nullptr
         );
 
         vk::DescriptorSetLayoutBinding samplerLayoutBinding = vk::DescriptorSetLayoutBinding(
             1, vk::DescriptorType::eCombinedImageSampler, 1, vk::ShaderStageFlagBits::eFragment, nullptr
         );
 
+        vk::DescriptorSetLayoutBinding objectLayoutBinding = vk::DescriptorSetLayoutBinding(
+            2, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eVertex, nullptr
+        );
+
+        vk::DescriptorSetLayoutBinding instanceLayoutBinding = vk::DescriptorSetLayoutBinding(
+            3, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eVertex, nullptr
+        );
+
         descSetLayoutBindings.push_back(cameraLayoutBinding);
         descSetLayoutBindings.push_back(samplerLayoutBinding);
+        descSetLayoutBindings.push_back(objectLayoutBinding);
+        descSetLayoutBindings.push_back(instanceLayoutBinding);
 
         vk::DescriptorSetLayoutCreateInfo layoutCreateInfo(
             vk::DescriptorSetLayoutCreateFlags(),
@@ -59,7 +72,8 @@ namespace triangle
         descriptorSetLayout = device.getLogicalDevice().createDescriptorSetLayout(layoutCreateInfo);
     }
 
-    void Descriptor::createDescriptorSets(const std::vector<vk::Buffer> &buffers, const Swapchain::Texture &textureProperties)
+    void Descriptor::createDescriptorSets(const std::vector<vk::Buffer> &buffers, const std::vector<vk::Buffer> &objectBuffers,
+                                          const std::vector<vk::Buffer> &instanceBuffers, const Swapchain::Texture &textureProperties)
     {
         std::vector<vk::DescriptorSetLayout> layouts(descriptorCount, descriptorSetLayout);
         vk::DescriptorSetAllocateInfo allocInfo(descriptorPool, layouts);
@@ -68,38 +82,85 @@ namespace triangle
 
         descriptorSets = device.getLogicalDevice().allocateDescriptorSets(allocInfo);
 
-        std::vector<vk::DescriptorBufferInfo> bufferInfos;
+        std::vector<vk::DescriptorBufferInfo> bufferInfos, objectBufferInfos, instanceBufferInfos;
         bufferInfos.reserve(descriptorCount);
+        objectBufferInfos.reserve(descriptorCount);
+        instanceBufferInfos.reserve(descriptorCount);
 
         std::vector<vk::DescriptorImageInfo> imageInfos;
         imageInfos.reserve(descriptorCount);
 
         std::vector<vk::WriteDescriptorSet> descriptorWrites;
-        descriptorWrites.reserve(descriptorCount * 2);
+        descriptorWrites.reserve(descriptorCount * 4);
 
         for (int i = 0; i < descriptorCount; ++i)
         {
-            // dynamic UBO
+            // camera UBO
             bufferInfos.push_back(vk::DescriptorBufferInfo(
-                buffers[i], 0, sizeof(MVP)
+                buffers[i], 0, sizeof(CameraData)
+            ));
+
+            // per object SSBO
+            objectBufferInfos.push_back(vk::DescriptorBufferInfo(
+                objectBuffers[i], 0, VK_WHOLE_SIZE
+            ));
+
+            // per instance SSBO
+            instanceBufferInfos.push_back(vk::DescriptorBufferInfo(
+                instanceBuffers[i], 0, VK_WHOLE_SIZE
             ));
 
             imageInfos.push_back(vk::DescriptorImageInfo(
                 textureProperties.sampler, textureProperties.imageView, textureProperties.imageLayout 
             ));
+        }
 
-            // Binding 0: Vertex shader dynamic UBO
+        // Each frame's set points at that frame's uniform, object and instance buffers
+        for (int i = 0; i < descriptorCount; ++i)
+        {
+            // Binding 0: Vertex shader camera UBO
             descriptorWrites.push_back(vk::WriteDescriptorSet(
-                descriptorSets[i], 0, 0, vk::DescriptorType::eUniformBufferDynamic, {}, bufferInfos
+                descriptorSets[i], 0, 0, vk::DescriptorType::eUniformBuffer, {}, bufferInfos[i]
             ));
 
             // Binding 1: texture
             descriptorWrites.push_back( vk::WriteDescriptorSet(
-                descriptorSets[i], 1, 0, vk::DescriptorType::eCombinedImageSampler, imageInfos
+                descriptorSets[i], 1, 0, vk::DescriptorType::eCombinedImageSampler, imageInfos[i]
+            ));
+
+            // Binding 2: Vertex shader model matrices
+            descriptorWrites.push_back(vk::WriteDescriptorSet(
+                descriptorSets[i], 2, 0, vk::DescriptorType::eStorageBuffer, {}, objectBufferInfos[i]
+            ));
+
+            // Binding 3: Vertex shader object slot of each instance
+            descriptorWrites.push_back(vk::WriteDescriptorSet(
+                descriptorSets[i], 3, 0, vk::DescriptorType::eStorageBuffer, {}, instanceBufferInfos[i]
             ));
+        }
+
+        device.getLogicalDevice().updateDescriptorSets(descriptorWrites, nullptr);
+
+    }
+
+    void Descriptor::updateStorageBuffers(uint32_t binding, const std::vector<vk::Buffer> &storageBuffers)
+    {
+        std::vector<vk::DescriptorBufferInfo> bufferInfos;
+        bufferInfos.reserve(descriptorCount);
 
-            device.getLogicalDevice().updateDescriptorSets(descriptorWrites[i], nullptr);
+        for (int i = 0; i < descriptorCount; ++i)
+            bufferInfos.push_back(vk::DescriptorBufferInfo(storageBuffers[i], 0, VK_WHOLE_SIZE));
+
+        std::vector<vk::WriteDescriptorSet> descriptorWrites;
+        descriptorWrites.reserve(descriptorCount);
+
+        for (int i = 0; i < descriptorCount; ++i)
+        {
+            descriptorWrites.push_back(vk::WriteDescriptorSet(
+                descriptorSets[i], binding, 0, vk::DescriptorType::eStorageBuffer, {}, bufferInfos[i]
+            ));
         }
 
+        device.getLogicalDevice().updateDescriptorSets(descriptorWrites, nullptr);
     }
-}
\ No newline at end of file
+}
@@ -12,7 +12,9 @@ namespace triangle
     class Descriptor
     {
     public:
-        Descriptor(Device &device, uint32_t descriptorCount, const std::vector<vk::Buffer> &buffers, const Swapchain::Texture &textureProperties);
+        Descriptor(Device &device, uint32_t descriptorCount, const std::vector<vk::Buffer> &buffers,
+                   const std::vector<vk::Buffer> &objectBuffers, const std::vector<vk::Buffer> &instanceBuffers,
+                   const Swapchain::Texture &textureProperties);
         ~Descriptor();
 
         vk::DescriptorSet getDescriptorSet(uint32_t index) { return descriptorSets[index]; };
@@ -20,7 +22,14 @@ namespace triangle
 
         void createDescriptorPool();
         void createDescriptorSetLayout();
-        void createDescriptorSets(const std::vector<vk::Buffer> &buffers, const Swapchain::Texture& textureProperties);
+        void createDescriptorSets(const std::vector<vk::Buffer> &buffers, const std::vector<vk::Buffer> &objectBuffers,
+                                  const std::vector<vk::Buffer> &instanceBuffers, const Swapchain::Texture& textureProperties);
+
+        // Point binding 2 (objects) or 3 (instances) of every set at the
+        // matching buffer, e.g. after the buffers were recreated. The sets
+        // must not be in use.
+        void updateObjectBuffers(const std::vector<vk::Buffer> &objectBuffers) { updateStorageBuffers(2, objectBuffers); }
+        void updateInstanceBuffers(const std::vector<vk::Buffer> &instanceBuffers) { updateStorageBuffers(3, instanceBuffers); }
 
     private:
         Device& device;
@@ -33,5 +42,7 @@ namespace triangle
         vk::DescriptorSetLayout descriptorSetLayout;
         vk::DescriptorSetLayoutBinding descSetLayoutBinding;
 
+        void updateStorageBuffers(uint32_t binding, const std::vector<vk::Buffer> &storageBuffers);
+
     };
 }
\ No newline at end of file
@@ -44,7 +44,7 @@ namespace triangle
 
     Device::~Device()
     {
-        device.destroyCommandPool(mainCommandPool);
+        device.destroyCommandPool(uploadCommandPool);
         device.destroy();
         instance.destroySurfaceKHR(surface);    
         if (enableValidationLayers)
@@ -126,7 +126,7 @@ namespace triangle
     void Device::beginSingleTimeCommands(vk::CommandBuffer& cmdBuffer)
     {
         vk::CommandBufferAllocateInfo allocInfo(
-            mainCommandPool,
+            uploadCommandPool,
             vk::CommandBufferLevel::ePrimary,
             1
         );
@@ -151,15 +151,15 @@ namespace triangle
         graphicsQueue.submit(submitInfo);
         graphicsQueue.waitIdle();
 
-        device.freeCommandBuffers(mainCommandPool, cmdBuffer);
+        device.freeCommandBuffers(uploadCommandPool, cmdBuffer);
     }
 
-    void Device::copyBuffer(vk::Buffer& srcBuffer, vk::Buffer& dstBuffer, vk::DeviceSize size)
+    void Device::copyBuffer(vk::Buffer& srcBuffer, vk::Buffer& dstBuffer, vk::DeviceSize size, vk::DeviceSize dstOffset)
     {
         std::array<vk::CommandBuffer, 1> commandBuffer;
         beginSingleTimeCommands(commandBuffer[0]);
     
-        vk::BufferCopy copyRegion({}, {}, size);
+        vk::BufferCopy copyRegion({}, dstOffset, size);
         commandBuffer[0].copyBuffer(srcBuffer, dstBuffer, copyRegion);
 
         endSingleTimeCommand(commandBuffer[0]);
@@ -267,9 +267,24 @@ namespace triangle
         vk::PhysicalDeviceFeatures deviceFeatures;
         deviceFeatures.samplerAnisotropy = VK_TRUE;
 
+        // Used by the GPU culling pass, which falls back to one indirect draw
+        // per command without them
+        multiDrawIndirect = physicalDevice.getFeatures().multiDrawIndirect;
+        deviceFeatures.multiDrawIndirect = multiDrawIndirect;
+
+        vk::PhysicalDeviceVulkan12Features vulkan12Features;
+        if (physicalDevice.getProperties().apiVersion >= VK_API_VERSION_1_2)
+        {
+            auto features = physicalDevice.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceVulkan12Features>();
+            drawIndirectCount = features.get<vk::PhysicalDeviceVulkan12Features>().drawIndirectCount;
+        }
+        vulkan12Features.drawIndirectCount = drawIndirectCount;
+
         vk::DeviceQueueCreateInfo deviceQueueCreateInfo(vk::DeviceQueueCreateFlags(), queueFamilyIndex.graphics, 1, &queuePriority);
 
         vk::DeviceCreateInfo deviceCreateInfo = vk::DeviceCreateInfo(vk::DeviceCreateFlags(), deviceQueueCreateInfo, {}, deviceExtensions, &deviceFeatures);
+        if (drawIndirectCount)
+            deviceCreateInfo.setPNext(&vulkan12Features);
         if (enableValidationLayers)
         {
             deviceCreateInfo.setPEnabledLayerNames(validationLayers);
@@ -282,8 +297,9 @@ namespace triangle
 
     void Device::createCommandPool()
     {
-        vk::CommandPoolCreateInfo commandPoolCreateInfo(vk::CommandPoolCreateFlagBits::eResetCommandBuffer, queueFamilyIndex.graphics);
-        mainCommandPool = device.createCommandPool(commandPoolCreateInfo);
+        // Its command buffers are short lived, allocated and freed around each upload
+        vk::CommandPoolCreateInfo commandPoolCreateInfo(vk::CommandPoolCreateFlagBits::eTransient, queueFamilyIndex.graphics);
+        uploadCommandPool = device.createCommandPool(commandPoolCreateInfo);
     }
 
     void Device::createDebugMessenger(vk::DebugUtilsMessengerCreateInfoEXT& debugMessengerCreateInfo)
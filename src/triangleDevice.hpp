@@ -16,17 +16,23 @@ namespace triangle
         vk::Device getLogicalDevice() { return device; };
         vk::SurfaceKHR getSurface() { return static_cast<vk::SurfaceKHR>(surface); };
         auto getQueueFamilyIndex() { return queueFamilyIndex; };
-        vk::CommandPool getCommandPool() { return mainCommandPool; };
+        // Only for one-shot upload commands, see beginSingleTimeCommands.
+        // Per frame recording uses the renderer's own pools.
+        vk::CommandPool getUploadCommandPool() { return uploadCommandPool; };
 
         vk::Queue getGraphicsQueue() { return graphicsQueue; };
         vk::Queue getPresentQueue() { return presentQueue; };
 
         vk::Instance getInstance() { return instance; };
 
+        // Optional features, enabled at device creation when supported
+        bool supportsMultiDrawIndirect() { return multiDrawIndirect; }
+        bool supportsDrawIndirectCount() { return drawIndirectCount; }
+
         void beginSingleTimeCommands(vk::CommandBuffer& cmdBuffer);
         void endSingleTimeCommand(vk::CommandBuffer& cmdBuffer);
 
-        void copyBuffer(vk::Buffer& srcBuffer, vk::Buffer& dstBuffer, vk::DeviceSize size);
+        void copyBuffer(vk::Buffer& srcBuffer, vk::Buffer& dstBuffer, vk::DeviceSize size, vk::DeviceSize dstOffset = 0);
         void createBuffer(  vk::DeviceSize size, 
                             vk::BufferUsageFlags usage, 
                             vk::MemoryPropertyFlags properties, 
@@ -55,7 +61,9 @@ namespace triangle
         vk::Device device;
         vk::Queue graphicsQueue;
         vk::Queue presentQueue;
-        vk::CommandPool mainCommandPool;
+        vk::CommandPool uploadCommandPool;
+
+        bool multiDrawIndirect = false, drawIndirectCount = false;
 
         vk::PhysicalDeviceMemoryProperties memProperties;
         vk::MemoryRequirements memRequirements;
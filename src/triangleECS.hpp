@@ -3,9 +3,12 @@
 #include <iostream>
 #include <vector>
 #include <bitset>
-#include <unordered_map>
+#include <type_traits>
 #include <optional>
 #include <algorithm>
+#include <limits>
+#include <memory>
+#include <tuple>
 
 namespace triangle
 {
@@ -14,90 +17,579 @@ namespace triangle
 
 	static constexpr ComponentID maxComponents = 50;
 
-	static EntityID g_EntityID = 0;
-	static ComponentID g_ComponentID = 0;
-	struct Entity
+	static constexpr uint32_t npos = std::numeric_limits<uint32_t>::max();
+
+	using Signature = std::bitset<maxComponents>;
+
+	// Reads and writes the raw ECS storage, see triangleScene.hpp
+	class SceneSerializer;
+
+	// Compile-time component ids: a component's id is its index in the
+	// registered type list, so signatures can be built as constant masks.
+	template <typename... Components>
+	struct ComponentRegistry
 	{
-		Entity() : id{++g_EntityID}
-		{};
+		static_assert(sizeof...(Components) <= maxComponents, "too many component types");
+		static_assert(maxComponents <= 64, "signature masks are built from a 64-bit word");
 
-		EntityID id;
+		static constexpr ComponentID count = sizeof...(Components);
 
-		bool operator==(const Entity &other)
+		template <typename T>
+		static constexpr ComponentID id()
 		{
-			return this->id == other.id;
+			constexpr bool matches[] = {std::is_same_v<T, Components>..., false};
+			ComponentID index = 0;
+			while (index < count && !matches[index])
+				++index;
+
+			return index;
+		}
+
+		template <typename T>
+		static constexpr bool contains() { return id<T>() < count; }
+
+		template <typename... Ts>
+		static constexpr Signature signature()
+		{
+			static_assert((contains<Ts>() && ...), "component type is not registered");
+			return Signature(((1ull << id<Ts>()) | ... | 0ull));
 		}
 	};
 
-	template <typename T>
-	static std::unordered_map<ComponentID, T> g_Components;
+	// Handle to an entity slot. The generation is bumped every time the slot is
+	// freed, so handles kept past deleteEntity() no longer resolve.
+	// Slot 0 is never allocated, a default constructed Entity is null.
+	struct Entity
+	{
+		EntityID id = 0;
+		uint32_t generation = 0;
 
-	class ECS
+		bool operator==(const Entity &other) const
+		{
+			return this->id == other.id && this->generation == other.generation;
+		}
+	};
+
+	// Sparse set: m_Sparse maps an entity id to its slot in the packed arrays,
+	// so lookup is two indexings and iteration walks contiguous memory.
+	template <typename T>
+	class ComponentPool
 	{
 	public:
-		std::vector<Entity> getEntities() { return m_Entities; }
-		uint32_t getEntitySize() { return g_EntityID; }
-		bool deleteEntity(Entity& a_Entity)
+		ComponentPool() = default;
+		ComponentPool(const ComponentPool&) = default;
+		ComponentPool(ComponentPool&&) = default;
+		ComponentPool& operator=(ComponentPool&&) = default;
+
+		// Reuses this pool's allocations, trivially copyable components are
+		// copied as one block. Components holding references (RenderModel) are
+		// not assignable and get copy constructed one by one instead.
+		ComponentPool& operator=(const ComponentPool& a_Other)
 		{
-			if (a_Entity.id == 0)
+			if (this == &a_Other)
+				return *this;
+
+			m_Sparse = a_Other.m_Sparse;
+			m_Entities = a_Other.m_Entities;
+			m_ChangeTicks = a_Other.m_ChangeTicks;
+
+			if constexpr (std::is_copy_assignable_v<T>)
+				m_Components = a_Other.m_Components;
+			else
+			{
+				m_Components.clear();
+				m_Components.reserve(a_Other.m_Components.size());
+				for (const T& component : a_Other.m_Components)
+					m_Components.push_back(component);
+			}
+
+			return *this;
+		}
+
+		size_t size() const { return m_Components.size(); }
+		T* data() { return m_Components.data(); }
+		const std::vector<EntityID>& getEntities() const { return m_Entities; }
+		const std::vector<uint32_t>& getSparse() const { return m_Sparse; }
+		const std::vector<uint32_t>& getChangeTicks() const { return m_ChangeTicks; }
+
+		bool contains(EntityID a_EntityID) const
+		{
+			return a_EntityID < m_Sparse.size() && m_Sparse[a_EntityID] != npos;
+		}
+
+		T* get(EntityID a_EntityID)
+		{
+			if (!contains(a_EntityID))
+				return nullptr;
+
+			return &m_Components[m_Sparse[a_EntityID]];
+		}
+
+		// Unchecked, the caller already knows the entity owns a T
+		T& at(EntityID a_EntityID) { return m_Components[m_Sparse[a_EntityID]]; }
+
+		void setChangeTick(EntityID a_EntityID, uint32_t a_Tick) { m_ChangeTicks[m_Sparse[a_EntityID]] = a_Tick; }
+
+		// Keeps the existing component if the entity already has one
+		T* insert(EntityID a_EntityID, const T& a_Component, uint32_t a_Tick = 0)
+		{
+			if (contains(a_EntityID))
+				return &m_Components[m_Sparse[a_EntityID]];
+
+			if (a_EntityID >= m_Sparse.size())
+				m_Sparse.resize(a_EntityID + 1, npos);
+
+			m_Sparse[a_EntityID] = static_cast<uint32_t>(m_Components.size());
+			m_Entities.push_back(a_EntityID);
+			m_Components.push_back(a_Component);
+			m_ChangeTicks.push_back(a_Tick);
+
+			return &m_Components.back();
+		}
+
+		// Appends a copy of a_Component for every id, the entities must not own
+		// a T yet (e.g. freshly created ones)
+		void insertBulk(const std::vector<EntityID>& a_EntityIDs, const T& a_Component, uint32_t a_Tick = 0)
+		{
+			if (a_EntityIDs.empty())
+				return;
+
+			EntityID maxID = *std::max_element(a_EntityIDs.begin(), a_EntityIDs.end());
+			if (maxID >= m_Sparse.size())
+				m_Sparse.resize(maxID + 1, npos);
+
+			uint32_t first = static_cast<uint32_t>(m_Components.size());
+			for (uint32_t i = 0; i < a_EntityIDs.size(); ++i)
+				m_Sparse[a_EntityIDs[i]] = first + i;
+
+			m_Entities.insert(m_Entities.end(), a_EntityIDs.begin(), a_EntityIDs.end());
+			m_ChangeTicks.insert(m_ChangeTicks.end(), a_EntityIDs.size(), a_Tick);
+
+			if constexpr (std::is_copy_assignable_v<T>)
+				m_Components.insert(m_Components.end(), a_EntityIDs.size(), a_Component);
+			else
+			{
+				m_Components.reserve(m_Components.size() + a_EntityIDs.size());
+				for (size_t i = 0; i < a_EntityIDs.size(); ++i)
+					m_Components.push_back(a_Component);
+			}
+		}
+
+		bool remove(EntityID a_EntityID)
+		{
+			if (!contains(a_EntityID))
 				return false;
 
-			auto entityIndex = std::find(m_Entities.begin(), m_Entities.end(), a_Entity);
-			m_Entities.erase(entityIndex);
+			uint32_t index = m_Sparse[a_EntityID];
+			uint32_t last = static_cast<uint32_t>(m_Components.size() - 1);
+
+			if (index != last)
+			{
+				// Components holding references (RenderModel) are not assignable,
+				// so rebuild the slot in place instead.
+				if constexpr (std::is_move_assignable_v<T>)
+					m_Components[index] = std::move(m_Components[last]);
+				else
+				{
+					std::destroy_at(&m_Components[index]);
+					std::construct_at(&m_Components[index], std::move(m_Components[last]));
+				}
+
+				m_Entities[index] = m_Entities[last];
+				m_ChangeTicks[index] = m_ChangeTicks[last];
+				m_Sparse[m_Entities[index]] = index;
+			}
 
-			a_Entity.id = 0;
+			m_Components.pop_back();
+			m_Entities.pop_back();
+			m_ChangeTicks.pop_back();
+			m_Sparse[a_EntityID] = npos;
 
 			return true;
 		}
 
-		void addEntity(Entity& a_Entity)
+	private:
+		friend class SceneSerializer;
+
+		std::vector<uint32_t> m_Sparse;
+		std::vector<EntityID> m_Entities;
+		std::vector<T> m_Components;
+
+		// ECS tick of the last assign/markChanged, parallel to m_Components
+		std::vector<uint32_t> m_ChangeTicks;
+	};
+
+	// Generational handle allocation shared by the ECS storage layouts.
+	// Freed slots are recycled through a free list, the live list is kept
+	// packed with swap-and-pop.
+	class EntityAllocator
+	{
+	public:
+		EntityAllocator() : m_Generations(1, 0), m_EntityIndices(1, npos) {}
+
+		const std::vector<Entity>& getEntities() const { return m_Entities; }
+		const std::vector<uint32_t>& getGenerations() const { return m_Generations; }
+
+		bool isAlive(const Entity& a_Entity) const
+		{
+			return a_Entity.id != 0 && a_Entity.id < m_Generations.size()
+				&& m_Generations[a_Entity.id] == a_Entity.generation
+				&& m_EntityIndices[a_Entity.id] != npos;
+		}
+
+		Entity create()
+		{
+			EntityID id;
+			if (!m_FreeList.empty())
+			{
+				id = m_FreeList.back();
+				m_FreeList.pop_back();
+			}
+			else
+			{
+				id = static_cast<EntityID>(m_Generations.size());
+				m_Generations.push_back(1);
+				m_EntityIndices.push_back(npos);
+			}
+
+			m_EntityIndices[id] = static_cast<uint32_t>(m_Entities.size());
+			m_Entities.push_back(Entity{id, m_Generations[id]});
+
+			return m_Entities.back();
+		}
+
+		// Appends a_Count new handles to a_Out. Recycled slots are used first,
+		// the rest are allocated as one block.
+		void create(uint32_t a_Count, std::vector<Entity>& a_Out)
+		{
+			a_Out.reserve(a_Out.size() + a_Count);
+			m_Entities.reserve(m_Entities.size() + a_Count);
+
+			uint32_t recycled = std::min(a_Count, static_cast<uint32_t>(m_FreeList.size()));
+			for (uint32_t i = 0; i < recycled; ++i)
+				a_Out.push_back(create());
+
+			uint32_t fresh = a_Count - recycled;
+			EntityID first = static_cast<EntityID>(m_Generations.size());
+			m_Generations.resize(first + fresh, 1);
+			m_EntityIndices.resize(first + fresh);
+
+			for (EntityID id = first; id < first + fresh; ++id)
+			{
+				m_EntityIndices[id] = static_cast<uint32_t>(m_Entities.size());
+				m_Entities.push_back(Entity{id, 1});
+				a_Out.push_back(m_Entities.back());
+			}
+		}
+
+		// Expects a live handle
+		void destroy(const Entity& a_Entity)
+		{
+			uint32_t index = m_EntityIndices[a_Entity.id];
+			m_Entities[index] = m_Entities.back();
+			m_EntityIndices[m_Entities[index].id] = index;
+			m_Entities.pop_back();
+			m_EntityIndices[a_Entity.id] = npos;
+
+			// generation 0 is reserved for the null entity
+			if (++m_Generations[a_Entity.id] == 0)
+				m_Generations[a_Entity.id] = 1;
+			m_FreeList.push_back(a_Entity.id);
+		}
+
+	private:
+		friend class SceneSerializer;
+
+		// Indexed by EntityID
+		std::vector<uint32_t> m_Generations;
+		std::vector<uint32_t> m_EntityIndices;
+
+		std::vector<Entity> m_Entities;
+		std::vector<EntityID> m_FreeList;
+	};
+
+	// Iterates entities owning every component in Ts, driven by the smallest pool
+	// so the number of membership checks is bounded by the rarest component.
+	// Each candidate is accepted with a single signature mask test.
+	// Components must not be added or removed while iterating.
+	template <typename... Ts>
+	class View
+	{
+	public:
+		View(const std::vector<uint32_t>& a_Generations, const std::vector<Signature>& a_Signatures,
+			const Signature& a_Mask, ComponentPool<Ts>&... a_Pools)
+			: m_Pools{std::addressof(a_Pools)...}, m_Generations{a_Generations}, m_Signatures{a_Signatures}, m_Mask{a_Mask}
 		{
-			m_Entities.emplace_back(a_Entity);
+			m_Driver = std::min({&a_Pools.getEntities()...}, [](const auto* a, const auto* b)
+				{ return a->size() < b->size(); });
 		}
 
+		// Upper bound on the number of entities visited
+		size_t size() const { return m_Driver->size(); }
+
+		// Restricts the view to entities whose T was assigned or marked changed
+		// after a_Since (see ECS::advanceTick)
 		template <typename T>
-		bool assignComponent(Entity& a_Entity, const T &a_Component)
+		View changed(uint32_t a_Since) const
 		{
-			if (a_Entity.id == 0)
-				return false;
+			static_assert((std::is_same_v<T, Ts> || ...), "change filter must be one of the viewed components");
+
+			View filtered = *this;
+			filtered.m_FilterSparse = &std::get<ComponentPool<T>*>(m_Pools)->getSparse();
+			filtered.m_FilterTicks = &std::get<ComponentPool<T>*>(m_Pools)->getChangeTicks();
+			filtered.m_Since = a_Since;
+
+			return filtered;
+		}
+
+		template <typename Func>
+		void each(Func&& a_Func)
+		{
+			if constexpr (sizeof...(Ts) == 1)
+			{
+				auto* pool = std::get<0>(m_Pools);
+				auto* components = pool->data();
+				const auto& entities = pool->getEntities();
 
-			for (auto &entity : m_Entities)
+				for (size_t i = 0; i < entities.size(); ++i)
+				{
+					if (isChanged(entities[i]))
+						a_Func(Entity{entities[i], m_Generations[entities[i]]}, components[i]);
+				}
+			}
+			else
 			{
-				if (a_Entity == entity)
+				for (EntityID id : *m_Driver)
 				{
-					g_Components<T>.insert({a_Entity.id, a_Component});
+					if ((m_Signatures[id] & m_Mask) == m_Mask && isChanged(id))
+						a_Func(Entity{id, m_Generations[id]}, std::get<ComponentPool<Ts>*>(m_Pools)->at(id)...);
+				}
+			}
+		}
 
-					return true;
+		// Same as each(), but splits the dense range of the driving pool into
+		// chunks of a_Grain entities run through a_Executor.parallelFor (e.g.
+		// JobSystem). Chunks never overlap, so a_Func only needs to be safe for
+		// concurrent calls on different entities.
+		template <typename Executor, typename Func>
+		void parallelEach(Executor& a_Executor, uint32_t a_Grain, Func&& a_Func)
+		{
+			const auto& entities = *m_Driver;
+
+			a_Executor.parallelFor(static_cast<uint32_t>(entities.size()), a_Grain, [&](uint32_t a_Begin, uint32_t a_End)
+			{
+				if constexpr (sizeof...(Ts) == 1)
+				{
+					auto* components = std::get<0>(m_Pools)->data();
+					for (uint32_t i = a_Begin; i < a_End; ++i)
+					{
+						if (isChanged(entities[i]))
+							a_Func(Entity{entities[i], m_Generations[entities[i]]}, components[i]);
+					}
+				}
+				else
+				{
+					for (uint32_t i = a_Begin; i < a_End; ++i)
+					{
+						EntityID id = entities[i];
+						if ((m_Signatures[id] & m_Mask) == m_Mask && isChanged(id))
+							a_Func(Entity{id, m_Generations[id]}, std::get<ComponentPool<Ts>*>(m_Pools)->at(id)...);
+					}
 				}
+			});
+		}
+
+	private:
+		std::tuple<ComponentPool<Ts>*...> m_Pools;
+		const std::vector<EntityID>* m_Driver;
+		const std::vector<uint32_t>& m_Generations;
+		const std::vector<Signature>& m_Signatures;
+		Signature m_Mask;
+
+		// Set by changed<T>()
+		const std::vector<uint32_t>* m_FilterSparse = nullptr;
+		const std::vector<uint32_t>* m_FilterTicks = nullptr;
+		uint32_t m_Since = 0;
+
+		bool isChanged(EntityID a_EntityID) const
+		{
+			return m_FilterTicks == nullptr || (*m_FilterTicks)[(*m_FilterSparse)[a_EntityID]] > m_Since;
+		}
+	};
+
+	// Component values shared by every instance spawned with ECS::instantiate()
+	template <typename... Ts>
+	struct Prefab
+	{
+		std::tuple<Ts...> components;
+
+		Prefab(const Ts&... a_Components) : components{a_Components...} {}
+	};
+
+	// Sparse-set ECS over a fixed set of component types, e.g.
+	// ECS<RenderModel, Transform>. Using an unregistered type fails to compile.
+	// Each instance owns its component pools, so several worlds can live side
+	// by side and a world can be copied (see clone() and snapshot()).
+	template <typename... Components>
+	class ECS
+	{
+	public:
+		using Registry = ComponentRegistry<Components...>;
+
+		template <typename T>
+		static constexpr ComponentID componentID()
+		{
+			static_assert(Registry::template contains<T>(), "component type is not registered with this ECS");
+			return Registry::template id<T>();
+		}
+
+		template <typename... Ts>
+		static constexpr Signature signature() { return Registry::template signature<Ts...>(); }
+
+		const std::vector<Entity>& getEntities() const { return m_Allocator.getEntities(); }
+		// Live entities only, ids of deleted entities stay reserved
+		uint32_t getLiveEntityCount() const { return static_cast<uint32_t>(getEntities().size()); }
+		// Highest entity id handed out so far, dead or alive. Per-entity GPU
+		// slots indexed by id - 1 need this many entries.
+		uint32_t getEntitySlotCount() const { return static_cast<uint32_t>(m_Allocator.getGenerations().size()) - 1; }
+		bool isAlive(const Entity& a_Entity) const { return m_Allocator.isAlive(a_Entity); }
+
+		const Signature& getSignature(const Entity& a_Entity) const { return m_Signatures[a_Entity.id]; }
+
+		// Changes are stamped with the current tick. A consumer keeps the value
+		// returned by its previous advanceTick() and passes it to
+		// View::changed<T>() to see only what was modified since then.
+		uint32_t getTick() const { return m_Tick; }
+		uint32_t advanceTick() { return m_Tick++; }
+
+		// Independent copy of the whole world, e.g. for a preview or a
+		// simulation running next to the live one
+		ECS clone() const { return *this; }
+
+		// Overwrites a_Snapshot with the current state, reusing the memory it
+		// already holds. Rolling back is restore() with the same snapshot.
+		void snapshot(ECS& a_Snapshot) const { a_Snapshot = *this; }
+		void restore(const ECS& a_Snapshot) { *this = a_Snapshot; }
+
+		bool deleteEntity(Entity& a_Entity)
+		{
+			if (!isAlive(a_Entity))
+				return false;
+
+			Signature& entitySignature = m_Signatures[a_Entity.id];
+			((entitySignature.test(componentID<Components>()) ? (void)pool<Components>().remove(a_Entity.id) : (void)0), ...);
+			entitySignature.reset();
+
+			m_Allocator.destroy(a_Entity);
+			a_Entity = Entity{};
+
+			return true;
+		}
+
+		Entity addEntity()
+		{
+			Entity entity = m_Allocator.create();
+			if (entity.id >= m_Signatures.size())
+				m_Signatures.resize(entity.id + 1);
+
+			return entity;
+		}
+
+		// Creates a_Count entities owning copies of the prefab's components.
+		// Handles are allocated in bulk and every pool grows once.
+		template <typename... Ts>
+		std::vector<Entity> instantiate(const Prefab<Ts...>& a_Prefab, uint32_t a_Count)
+		{
+			std::vector<Entity> entities;
+			m_Allocator.create(a_Count, entities);
+
+			std::vector<EntityID> ids;
+			ids.reserve(entities.size());
+			EntityID maxID = 0;
+			for (const Entity& entity : entities)
+			{
+				ids.push_back(entity.id);
+				maxID = std::max(maxID, entity.id);
 			}
 
-			return false;
+			if (maxID >= m_Signatures.size())
+				m_Signatures.resize(maxID + 1);
+
+			const Signature mask = signature<Ts...>();
+			for (EntityID id : ids)
+				m_Signatures[id] = mask;
+
+			(pool<Ts>().insertBulk(ids, std::get<Ts>(a_Prefab.components), m_Tick), ...);
+
+			return entities;
+		}
+
+		template <typename T>
+		bool assignComponent(const Entity& a_Entity, const T &a_Component)
+		{
+			if (!isAlive(a_Entity))
+				return false;
+
+			pool<T>().insert(a_Entity.id, a_Component, m_Tick);
+			m_Signatures[a_Entity.id].set(componentID<T>());
+
+			return true;
+		}
+
+		// Call after writing through getComponent() or a view
+		template <typename T>
+		bool markChanged(const Entity& a_Entity)
+		{
+			if (!isAlive(a_Entity) || !m_Signatures[a_Entity.id].test(componentID<T>()))
+				return false;
+
+			pool<T>().setChangeTick(a_Entity.id, m_Tick);
+
+			return true;
 		}
 
 		template <typename T>
 		T* getComponent(const Entity& a_Entity)
 		{
-			if (a_Entity.id == 0)
+			if (!isAlive(a_Entity) || !m_Signatures[a_Entity.id].test(componentID<T>()))
 				return nullptr;
 
-			auto search = g_Components<T>.find(a_Entity.id);
-			if (search == g_Components<T>.end())
-				return nullptr;
-			else
-				return &(search->second);
+			return &pool<T>().at(a_Entity.id);
+		}
+
+		template <typename... Ts>
+		View<Ts...> view()
+		{
+			return View<Ts...>(m_Allocator.getGenerations(), m_Signatures, signature<Ts...>(), pool<Ts>()...);
 		}
 
 		template <typename T>
-		bool deleteComponent(Entity& a_Entity)
+		bool deleteComponent(const Entity& a_Entity)
 		{
-			if (a_Entity.id == 0)
+			if (!isAlive(a_Entity))
 				return false;
 
-			g_Components<T>.erase(a_Entity.id);
+			pool<T>().remove(a_Entity.id);
+			m_Signatures[a_Entity.id].reset(componentID<T>());
 			
 			return true;
 		}
 	private:
-		std::vector<Entity> m_Entities;
+		friend class SceneSerializer;
+
+		std::tuple<ComponentPool<Components>...> m_Pools;
+		EntityAllocator m_Allocator;
+
+		// Indexed by EntityID
+		std::vector<Signature> m_Signatures;
+
+		uint32_t m_Tick = 1;
+
+		template <typename T>
+		ComponentPool<T>& pool()
+		{
+			static_assert(Registry::template contains<T>(), "component type is not registered with this ECS");
+			return std::get<ComponentPool<T>>(m_Pools);
+		}
 	};
 }
@@ -22,6 +22,7 @@
 
 #include <vulkan/vulkan.hpp>
 
+#include <algorithm>
 #include <array>
 #include <cstring>
 #include <iostream>
@@ -48,8 +49,29 @@ namespace triangle
     void Engine::run()
     {
         triangleModel = std::make_unique<Model>(triangleDevice);
-        triangleModel->createUniformBuffers(triangleRenderer.getMaxFramesInFlight(), 2);
-        triangleDescriptor = std::make_unique<Descriptor>(triangleDevice, triangleRenderer.getMaxFramesInFlight(), triangleModel->getUniformBuffers(), triangleRenderer.getTextureProperties());
+        triangleModel->createUniformBuffers(triangleRenderer.getMaxFramesInFlight());
+        triangleRenderer.createSecondaryCommandPools(jobSystem.getWorkerCount());
+
+        // The scene's entities exist before the per-entity buffers, which are
+        // indexed by id - 1. Each entity draws at most one instance, so the
+        // slot count covers both and the first frame does not grow them.
+        triangle::Entity cubeEntity = ecs.addEntity(),
+                         squareEntity = ecs.addEntity();
+
+        triangleModel->createObjectBuffers(triangleRenderer.getMaxFramesInFlight(), ecs.getEntitySlotCount());
+        triangleModel->createInstanceBuffers(triangleRenderer.getMaxFramesInFlight(), ecs.getEntitySlotCount());
+        triangleDescriptor = std::make_unique<Descriptor>(triangleDevice, triangleRenderer.getMaxFramesInFlight(), triangleModel->getUniformBuffers(),
+                                                          triangleModel->getObjectBuffers(), triangleModel->getInstanceBuffers(),
+                                                          triangleRenderer.getTextureProperties());
+
+        try
+        {
+            gpuCulling = std::make_unique<GpuCulling>(triangleDevice, trianglePipeline, triangleRenderer.getMaxFramesInFlight());
+        }
+        catch (const std::runtime_error& error)
+        {
+            std::cerr << "GPU culling unavailable, falling back to CPU culling: " << error.what() << '\n';
+        }
 
         // initEntities();
         Mesh cubeMesh = Mesh(cubeVertices, cubeIndices),
@@ -70,22 +92,28 @@ namespace triangle
         Material defaultMaterial{.pipelineLayout = defaultPipelineLayout, .pipeline = defaultPipeline},
             textureMaterial{.pipelineLayout = defaultPipelineLayout, .pipeline = texturedPipeline};
 
-        RenderModel cubeModel = RenderModel(cubeMesh, cubeTransform, defaultMaterial),
-                    squareModel = RenderModel(squareMesh, squareTransform, textureMaterial);
-
-        triangle::Entity cubeEntity = triangle::Entity(),
-                         squareEntity = triangle::Entity();
-
-        ecs.addEntity(cubeEntity);
-        ecs.addEntity(squareEntity);
+        RenderModel cubeModel = RenderModel(cubeMesh, defaultMaterial),
+                    squareModel = RenderModel(squareMesh, textureMaterial);
 
         ecs.assignComponent<RenderModel>(cubeEntity, cubeModel);
         ecs.assignComponent<RenderModel>(squareEntity, squareModel);
+        ecs.assignComponent<Transform>(cubeEntity, cubeTransform);
+        ecs.assignComponent<Transform>(squareEntity, squareTransform);
+
+        transformHierarchy.setParent(squareEntity, cubeEntity);
 
         triangleCamera = std::make_unique<TriangleCamera>(triangleWindow.getWindow(), WIDTH, HEIGHT);
         triangleCamera->setCamera(cameraPos, glm::vec3(0.f, 0.f, -1.f), glm::vec3(0.f, 1.f, 0.f));
 
-        initSceneSystem();
+        // Every world matrix is final before cullSystem reads it. Moved
+        // entities get their RenderModel marked changed, so instanceSystem
+        // uploads only their object data.
+        scheduler.addSystem("transform", ecs.signature<Transform>(),
+                            ecs.signature<RenderModel>() | resource(SystemResource::Hierarchy) | resource(SystemResource::Tick),
+                            [this] { transformSystem(); });
+        scheduler.addSystem("cull", ecs.signature<RenderModel>() | resource(SystemResource::Hierarchy),
+                            resource(SystemResource::DrawList),
+                            [this] { cullSystem(); });
 
         while (!triangleWindow.shouldClose())
         {
@@ -101,9 +129,39 @@ namespace triangle
                 triangleCamera->processCameraRotation(0.2f);
             }
 
+            // Deleted entities leave the hierarchy before their ids can be recycled
+            if (entityCommands.flush(ecs) > 0)
+                transformHierarchy.removeDead([this](const Entity& entity) { return ecs.isAlive(entity); });
+
+            // cullSystem looks up the mesh of every RenderModel
+            meshSystem();
+
+            // Read by the scheduled systems, which leave it untouched
+            cameraSystem();
+
+            scheduler.run();
+
+            // Recreated object buffers lose their contents, every object is uploaded again
+            if (triangleModel->reserveObjectBuffers(ecs.getEntitySlotCount()))
+            {
+                triangleDescriptor->updateObjectBuffers(triangleModel->getObjectBuffers());
+                objectUploadTicks.fill(0);
+                ++commandCacheGeneration;
+            }
+
+            // The instance buffers are rewritten every frame, only the descriptors need updating
+            if (triangleModel->reserveInstanceBuffers(static_cast<uint32_t>(ecs.view<RenderModel>().size())))
+            {
+                triangleDescriptor->updateInstanceBuffers(triangleModel->getInstanceBuffers());
+                ++commandCacheGeneration;
+            }
+
             if (auto currentCommandBuffer = triangleRenderer.beginCommandBuffer())
             {
-                triangleRenderer.beginRenderPass();
+                // May record compute work, which has to happen outside the render pass
+                instanceSystem(triangleRenderer.getCurrentFrame(), currentCommandBuffer);
+
+                triangleRenderer.beginRenderPass(useSecondaryCommandBuffers ? vk::SubpassContents::eSecondaryCommandBuffers : vk::SubpassContents::eInline);
 
                 renderSystem(triangleRenderer.getCurrentFrame(), currentCommandBuffer);
 
@@ -139,20 +197,20 @@ namespace triangle
         Material defaultMaterial{.pipelineLayout = defaultPipelineLayout, .pipeline = defaultPipeline},
             textureMaterial{.pipelineLayout = defaultPipelineLayout, .pipeline = texturedPipeline};
 
-        RenderModel cubeModel = RenderModel(cubeMesh, cubeTransform, defaultMaterial),
-                    squareModel = RenderModel(squareMesh, squareTransform, textureMaterial);
-        //    pyramidModel = RenderModel(pyramidMesh, pyramidTransform)
+        RenderModel cubeModel = RenderModel(cubeMesh, defaultMaterial),
+                    squareModel = RenderModel(squareMesh, textureMaterial);
+        //    pyramidModel = RenderModel(pyramidMesh, pyramidMaterial)
 
-        triangle::Entity cubeEntity = triangle::Entity(),
-                         squareEntity = triangle::Entity();
-        //  pyramidEntity = triangle::Entity()
-
-        ecs.addEntity(cubeEntity);
-        ecs.addEntity(squareEntity);
-        // ecs.addEntity(pyramidEntity);
+        triangle::Entity cubeEntity = ecs.addEntity(),
+                         squareEntity = ecs.addEntity();
+        //  pyramidEntity = ecs.addEntity()
 
         ecs.assignComponent<RenderModel>(cubeEntity, cubeModel);
         ecs.assignComponent<RenderModel>(squareEntity, squareModel);
+        ecs.assignComponent<Transform>(cubeEntity, cubeTransform);
+        ecs.assignComponent<Transform>(squareEntity, squareTransform);
+
+        transformHierarchy.setParent(squareEntity, cubeEntity);
     }
     void Engine::drawUI()
     {
@@ -162,19 +220,21 @@ namespace triangle
 
         if (ImGui::Begin("Entity"))
         {
-            for (const auto &entity : ecs.getEntities())
+            ecs.view<Transform>().each([&](Entity entity, Transform& transform)
             {
                 sprintf(entityID, "Entity %d", entity.id);
-                auto component = ecs.getComponent<RenderModel>(entity);
-                if (component == nullptr) continue;
 
                 ImGui::BeginChild(entityID, ImVec2(0, 100.f), true);
-                ImGui::Text("Entity ID: %d\nTransform component: %p", entity.id, std::addressof(component->transform.position));
-                ImGui::Text("translation: (%.3f, %.3f, %.3f)", component->transform.position.x, component->transform.position.y, component->transform.position.z);
-
-                ImGui::SliderFloat3("position", &(component->transform.position.x), 0.f, 10.f);
+                ImGui::Text("Entity ID: %d\nTransform component: %p", entity.id, std::addressof(transform.position));
+                ImGui::Text("translation: (%.3f, %.3f, %.3f)", transform.position.x, transform.position.y, transform.position.z);
+
+                bool changed = ImGui::SliderFloat3("position", &(transform.position.x), 0.f, 10.f);
+                changed |= ImGui::SliderFloat3("rotation", &(transform.rotation.x), -glm::pi<float>(), glm::pi<float>());
+                changed |= ImGui::SliderFloat3("scale", &(transform.scale.x), 0.1f, 10.f);
+                if (changed)
+                    ecs.markChanged<Transform>(entity);
                 ImGui::EndChild();
-            }
+            });
         }
         ImGui::End();
 
@@ -193,7 +253,60 @@ namespace triangle
 
         if (ImGui::Begin("Device Properties"))
         {
-            ImGui::Text("UBO dynamic offset: %d", triangleModel->getDynamicAlignment());
+            ImGui::Text("Camera UBO size: %zu", sizeof(CameraData));
+            ImGui::Text("Object buffer capacity: %u", triangleModel->getObjectBufferCapacity());
+            ImGui::Text("Instance buffer capacity: %u", triangleModel->getInstanceBufferCapacity());
+        }
+        ImGui::End();
+
+        if (ImGui::Begin("Render queue"))
+        {
+            ImGui::Text("Queued draws: %zu", renderQueue.size());
+            ImGui::Text("Draw calls: %u", renderStats.draws);
+            ImGui::Text("Pipeline binds: %u", renderStats.pipelineBinds);
+            ImGui::Text("Descriptor set binds: %u", renderStats.descriptorBinds);
+            ImGui::Text("Visible: %u / %u, culled: %u (%s)", cullStats.visible, cullStats.tested, cullStats.tested - cullStats.visible,
+                        useGpuCulling ? "GPU" : useCpuCulling ? "CPU" : "off");
+
+            ImGui::Checkbox("Secondary command buffers", &useSecondaryCommandBuffers);
+            if (useSecondaryCommandBuffers)
+            {
+                ImGui::Text("Recording threads: %zu", recordSlices.size());
+
+                ImGui::Checkbox("Cache static slices", &useCommandCache);
+                uint32_t reusedSlices = static_cast<uint32_t>(std::count_if(recordSlices.begin(), recordSlices.end(), [](const RecordSlice& slice) { return slice.reused; }));
+                ImGui::Text("Reused slices: %u / %zu", reusedSlices, recordSlices.size());
+            }
+        }
+        ImGui::End();
+
+        if (ImGui::Begin("Culling"))
+        {
+            ImGui::Checkbox("CPU culling", &useCpuCulling);
+            ImGui::Text("CPU kernels: %s", getSimdLevelName(getSimdLevel()));
+
+            ImGui::Separator();
+
+            if (gpuCulling)
+            {
+                ImGui::Checkbox("GPU culling", &useGpuCulling);
+                ImGui::Text("Indirect count: %s", triangleDevice.supportsDrawIndirectCount() ? "yes" : "no");
+            }
+            else
+                ImGui::Text("GPU culling unavailable");
+        }
+        ImGui::End();
+
+        if (ImGui::Begin("Jobs"))
+        {
+            auto stats = jobSystem.getStats();
+            for (uint32_t i = 0; i < stats.size(); ++i)
+                ImGui::Text("Worker %u: %llu jobs, %llu steals, %.2f ms idle", i, (unsigned long long)stats[i].jobsRun, (unsigned long long)stats[i].steals, stats[i].idleMilliseconds);
+
+            ImGui::Text("Transform kernels: %s", getSimdLevelName(getSimdLevel()));
+
+            if (ImGui::Button("Reset"))
+                jobSystem.resetStats();
         }
         ImGui::End();
 
@@ -222,77 +335,333 @@ namespace triangle
 
     void Engine::renderSystem(uint32_t currentImage, vk::CommandBuffer& currentCommandBuffer)
     {
-        vk::DeviceSize dynamicOffset = 0;
-        vk::DeviceSize vertexOffset = 0, indexOffset = 0;
+        // The camera is shared by every draw. Model matrices and object slots
+        // were written by instanceSystem, or the slots by the cull shader.
+        CameraData camera{cameraView, cameraProj, cameraProj * cameraView};
+        memcpy(triangleModel->getUniformBufferMapping(currentImage), &camera, sizeof(camera));
+
+        renderStats = RenderStats{};
+
+        // GPU culling draws a whole pipeline run with one indirect call
+        uint32_t drawCount = static_cast<uint32_t>(useGpuCulling ? drawRuns.size() : drawGroups.size());
+
+        if (!useSecondaryCommandBuffers)
+        {
+            recordSlices.clear();
+            recordDraws(currentCommandBuffer, currentImage, 0, drawCount, renderStats);
+            return;
+        }
 
-        static vk::Pipeline* lastPipeline = nullptr;
-        // trianglePipeline.bind(currentCommandBuffer);
+        uint32_t sliceCount = std::min(jobSystem.getWorkerCount(), (drawCount + minDrawsPerSlice - 1) / minDrawsPerSlice);
+        uint32_t sliceSize = sliceCount > 0 ? (drawCount + sliceCount - 1) / sliceCount : 0;
+        recordSlices.assign(sliceCount, RecordSlice{});
 
-        for (const auto &entity : ecs.getEntities())
+        // Each counter only grows, so the sum changes whenever one of them does
+        uint64_t generation = uint64_t(commandCacheGeneration) + triangleRenderer.getSwapchainGeneration() +
+                              (gpuCulling ? gpuCulling->getBufferGeneration() : 0);
+
+        if (useCommandCache)
         {
-            if (auto component = ecs.getComponent<RenderModel>(entity))
+            recordedDraws.clear();
+            for (uint32_t i = 0; i < drawCount; ++i)
             {
-                // update uniforms
-                glm::mat4 transform = glm::translate(glm::mat4{1.0f}, component->transform.position);
+                if (useGpuCulling)
+                {
+                    const DrawRun& run = drawRuns[i];
+                    recordedDraws.push_back(RecordedDraw{run.material->pipeline, run.material->pipelineLayout, i, run.firstGroup, run.groupCount, true});
+                }
+                else
+                {
+                    const DrawGroup& group = drawGroups[i];
+                    recordedDraws.push_back(RecordedDraw{group.material->pipeline, group.material->pipelineLayout, group.mesh, group.firstInstance, group.instanceCount, false});
+                }
+            }
 
-                cameraPos.x = sin(glfwGetTime()) * 10.0f;
-                cameraPos.z = cos(glfwGetTime()) * 10.0f;
+            if (cachedSlices[currentImage].size() < sliceCount)
+                cachedSlices[currentImage].resize(sliceCount);
+        }
 
-                component->mesh.mvp.model = transform;
-                component->mesh.mvp.view = triangleCamera->getView();
-                component->mesh.mvp.proj = glm::perspective(glm::radians(45.0f), triangleRenderer.getAspectRatio(), 0.1f, 20.0f);
+        // Each worker records from its own command pool, slices that land
+        // on the same worker get separate command buffers from it. Cached
+        // slices use the renderer slot of their slice index instead.
+        jobSystem.parallelFor(sliceCount, 1, [&](uint32_t begin, uint32_t end)
+        {
+            for (uint32_t slice = begin; slice < end; ++slice)
+            {
+                RecordSlice& recordSlice = recordSlices[slice];
+                uint32_t firstDraw = slice * sliceSize, endDraw = std::min((slice + 1) * sliceSize, drawCount);
+
+                if (!useCommandCache)
+                {
+                    recordSlice.commandBuffer = triangleRenderer.beginSecondaryCommandBuffer(jobSystem.getCurrentWorkerIndex());
+                    recordDraws(recordSlice.commandBuffer, currentImage, firstDraw, endDraw, recordSlice.stats);
+                    recordSlice.commandBuffer.end();
+                    continue;
+                }
+
+                CachedSlice& cachedSlice = cachedSlices[currentImage][slice];
+                auto first = recordedDraws.begin() + firstDraw, last = recordedDraws.begin() + endDraw;
+
+                if (cachedSlice.generation != generation || !std::equal(first, last, cachedSlice.draws.begin(), cachedSlice.draws.end()))
+                {
+                    cachedSlice.commandBuffer = triangleRenderer.beginCachedCommandBuffer(slice);
+                    cachedSlice.stats = RenderStats{};
+                    recordDraws(cachedSlice.commandBuffer, currentImage, firstDraw, endDraw, cachedSlice.stats);
+                    cachedSlice.commandBuffer.end();
+
+                    cachedSlice.draws.assign(first, last);
+                    cachedSlice.generation = generation;
+                }
+                else
+                {
+                    recordSlice.reused = true;
+                }
+
+                recordSlice.commandBuffer = cachedSlice.commandBuffer;
+                recordSlice.stats = cachedSlice.stats;
+            }
+        });
 
-                component->mesh.mvp.proj[1][1] *= -1;
+        secondaryCommandBuffers.clear();
+        for (const RecordSlice& recordSlice : recordSlices)
+        {
+            secondaryCommandBuffers.push_back(recordSlice.commandBuffer);
+            renderStats.draws += recordSlice.stats.draws;
+            renderStats.pipelineBinds += recordSlice.stats.pipelineBinds;
+            renderStats.descriptorBinds += recordSlice.stats.descriptorBinds;
+        }
 
-                void *data;
-                data = triangleDevice.getLogicalDevice().mapMemory(triangleModel->getUniformBufferMemory(currentImage), dynamicOffset, sizeof(component->mesh.mvp));
-                memcpy(data, &component->mesh.mvp, sizeof(component->mesh.mvp));
-                triangleDevice.getLogicalDevice().unmapMemory(triangleModel->getUniformBufferMemory(currentImage));
+        triangleRenderer.executeSecondaryCommandBuffers(secondaryCommandBuffers);
+    }
 
-                MeshPushConstant push{};
-                // push.offset = {0.0f + (frame * 0.005f * entity.id * entity.id), 0.0f, 0.0f + (frame * 0.005f * entity.id * entity.id)};
-                // push.color = {0.0f, 0.0f + (frame * 0.005f), 0.0f + (frame * 0.0025f)};
-                push.offset = {0.f, 0.f, 0.f};
-                push.color = {0.f, 0.f, 0.f};
+    void Engine::recordDraws(vk::CommandBuffer& commandBuffer, uint32_t currentImage, uint32_t begin, uint32_t end, RenderStats& stats)
+    {
+        triangleModel->bind(commandBuffer, 0, 0);
 
-                // Bind and draw
-                if (lastPipeline != std::addressof(component->material.pipeline))
-                    currentCommandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, component->material.pipeline);
-                
-                currentCommandBuffer.bindDescriptorSets(
-                    vk::PipelineBindPoint::eGraphics, component->material.pipelineLayout, 0, triangleDescriptor->getDescriptorSet(currentFrame), dynamicOffset);
+        vk::Pipeline boundPipeline = VK_NULL_HANDLE;
+        vk::PipelineLayout boundLayout = VK_NULL_HANDLE;
 
-                triangleModel->bind(currentCommandBuffer,
-                                    sizeof(component->mesh.vertices[0]) * component->mesh.vertices.size() * (entity.id - 1),
-                                    sizeof(component->mesh.indices[0]) * component->mesh.indices.size() * (entity.id - 1));
+        for (uint32_t i = begin; i < end; ++i)
+        {
+            const Material* material = useGpuCulling ? drawRuns[i].material : drawGroups[i].material;
 
-                currentCommandBuffer.drawIndexed(static_cast<uint32_t>(component->mesh.indices.size()), 1, 0, 0, 0);
+            if (material->pipeline != boundPipeline)
+            {
+                commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, material->pipeline);
+                boundPipeline = material->pipeline;
+                ++stats.pipelineBinds;
+            }
 
-                dynamicOffset = entity.id * triangleModel->getDynamicAlignment();
-                lastPipeline = std::addressof(component->material.pipeline);
+            if (material->pipelineLayout != boundLayout)
+            {
+                commandBuffer.bindDescriptorSets(
+                    vk::PipelineBindPoint::eGraphics, material->pipelineLayout, 0, triangleDescriptor->getDescriptorSet(currentImage), nullptr);
+                boundLayout = material->pipelineLayout;
+                ++stats.descriptorBinds;
+            }
+
+            if (useGpuCulling)
+            {
+                gpuCulling->drawRun(commandBuffer, currentImage, i, drawRuns[i].firstGroup, drawRuns[i].groupCount);
             }
+            else
+            {
+                const DrawGroup& group = drawGroups[i];
+                const MeshRange& range = triangleModel->getMeshRange(group.mesh);
+                commandBuffer.drawIndexed(range.indexCount, group.instanceCount, range.firstIndex, range.vertexOffset, group.firstInstance);
+            }
+            ++stats.draws;
         }
     }
 
-    void Engine::initSceneSystem()
+    uint32_t Engine::getPipelineID(vk::Pipeline pipeline)
     {
-        auto entities = ecs.getEntities();
+        auto it = std::find(pipelines.begin(), pipelines.end(), pipeline);
+        return static_cast<uint32_t>(it - pipelines.begin());
+    }
+
+    void Engine::cullSystem()
+    {
+        useGpuCulling &= gpuCulling != nullptr;
+
+        instanceDraws.clear();
+        ecs.view<RenderModel>().each([&](Entity entity, RenderModel& component)
+        {
+            instanceDraws.push_back(InstanceDraw{&component.material, getPipelineID(component.material.pipeline), meshIndices.at(component.mesh.id), entity});
+        });
+
+        drawModels.resize(instanceDraws.size());
+        for (uint32_t i = 0; i < instanceDraws.size(); ++i)
+        {
+            const glm::mat4* world = transformHierarchy.getWorld(instanceDraws[i].entity);
+            drawModels[i] = world ? *world : glm::mat4(1.f);
+        }
+
+        // CPU path: test the world bounding spheres before anything is recorded
+        bool cpuCulling = useCpuCulling && !useGpuCulling;
+        uint32_t drawCount = static_cast<uint32_t>(instanceDraws.size());
+        if (!useGpuCulling)
+            cullStats = CullStats{drawCount, drawCount};
+        if (cpuCulling)
+        {
+            cullBounds.clear();
+            for (uint32_t i = 0; i < instanceDraws.size(); ++i)
+                cullBounds.push_back(drawModels[i], triangleModel->getMeshRange(instanceDraws[i].mesh).boundingSphere);
 
-        std::vector<std::vector<Vertex>> vertexList{};
-        vertexList.reserve(entities.size());
+            drawVisibility.resize(instanceDraws.size());
+            cullStats.visible = cullSpheres(cullBounds, cameraFrustum, 0, cullBounds.size(), drawVisibility.data());
+        }
 
-        std::vector<std::vector<Index>> indexList{};
-        indexList.reserve(entities.size());
+        // Every draw shares the per frame descriptor set for now, so its key
+        // field is 0. Depth sorts front to back inside each (pipeline, mesh)
+        // batch, which keeps batches together and helps early depth rejection.
+        renderQueue.clear();
+        renderQueue.reserve(instanceDraws.size());
+        for (uint32_t i = 0; i < instanceDraws.size(); ++i)
+        {
+            if (cpuCulling && !drawVisibility[i])
+                continue;
 
-        for (auto& entity : entities)
+            float depth = -(cameraView * drawModels[i][3]).z / cameraFar;
+            renderQueue.push(RenderKey::make(0, instanceDraws[i].pipeline, 0, instanceDraws[i].mesh, depth), i);
+        }
+        renderQueue.sort();
+
+        // Each group owns [firstInstance, firstInstance + instanceCount) of the
+        // instance buffer. The CPU path fills it front to back with the visible
+        // draws, the GPU path reserves room for every draw and leaves it to the
+        // cull shader, which only writes survivors.
+        drawGroups.clear();
+        drawRuns.clear();
+        cullObjects.clear();
+        for (uint32_t instance = 0; instance < renderQueue.size(); ++instance)
         {
-            if (auto component = ecs.getComponent<RenderModel>(entity))
+            uint64_t key = renderQueue[instance].key;
+            uint32_t i = renderQueue[instance].index;
+            const InstanceDraw& draw = instanceDraws[i];
+
+            if (instance == 0 || RenderKey::batch(key) != RenderKey::batch(renderQueue[instance - 1].key))
             {
-                vertexList.push_back(component->mesh.vertices);
-                indexList.push_back(component->mesh.indices);
+                if (instance == 0 || RenderKey::pipeline(key) != RenderKey::pipeline(renderQueue[instance - 1].key))
+                    drawRuns.push_back(DrawRun{draw.material, static_cast<uint32_t>(drawGroups.size()), 0});
+
+                drawGroups.push_back(DrawGroup{draw.material, draw.mesh, instance, 0});
+                ++drawRuns.back().groupCount;
             }
+
+            ++drawGroups.back().instanceCount;
+
+            if (useGpuCulling)
+                cullObjects.push_back(GpuCulling::Object{draw.entity.id - 1, static_cast<uint32_t>(drawGroups.size() - 1), {}, triangleModel->getMeshRange(draw.mesh).boundingSphere});
+        }
+
+        if (!useGpuCulling)
+            return;
+
+        cullDraws.clear();
+        for (uint32_t run = 0; run < drawRuns.size(); ++run)
+        {
+            for (uint32_t i = drawRuns[run].firstGroup; i < drawRuns[run].firstGroup + drawRuns[run].groupCount; ++i)
+            {
+                const MeshRange& range = triangleModel->getMeshRange(drawGroups[i].mesh);
+                cullDraws.push_back(GpuCulling::DrawCommand{range.indexCount, 0, range.firstIndex, range.vertexOffset, drawGroups[i].firstInstance, run, drawRuns[run].firstGroup, 0});
+            }
+        }
+    }
+
+    void Engine::instanceSystem(uint32_t currentImage, vk::CommandBuffer& currentCommandBuffer)
+    {
+        // Each frame's object buffer keeps its entries, only objects changed
+        // since that buffer was last written are uploaded
+        uint32_t since = objectUploadTicks[currentImage];
+        objectUploadTicks[currentImage] = ecs.advanceTick();
+
+        ObjectData* objects = static_cast<ObjectData*>(triangleModel->getObjectBufferMapping(currentImage));
+        ecs.view<RenderModel>().changed<RenderModel>(since).parallelEach(jobSystem, 1024, [&](Entity entity, RenderModel&)
+        {
+            const glm::mat4* world = transformHierarchy.getWorld(entity);
+            objects[entity.id - 1].model = world ? *world : glm::mat4(1.f);
+        });
+
+        if (useGpuCulling)
+        {
+            gpuCulling->record(currentCommandBuffer, currentImage, cameraFrustum, cullObjects, cullDraws, static_cast<uint32_t>(drawRuns.size()),
+                               triangleModel->getObjectBuffer(currentImage), triangleModel->getInstanceBuffer(currentImage));
+            cullStats = CullStats{gpuCulling->getTestedCount(), gpuCulling->getVisibleCount()};
+            return;
         }
-        triangleModel->allocVertexBuffer(vertexList);
-        triangleModel->allocIndexBuffer(indexList);
+
+        uint32_t* slots = static_cast<uint32_t*>(triangleModel->getInstanceBufferMapping(currentImage));
+        for (uint32_t instance = 0; instance < renderQueue.size(); ++instance)
+            slots[instance] = instanceDraws[renderQueue[instance].index].entity.id - 1;
+    }
+
+    void Engine::cameraSystem()
+    {
+        cameraPos.x = sin(glfwGetTime()) * 10.0f;
+        cameraPos.z = cos(glfwGetTime()) * 10.0f;
+
+        // Camera input is processed on this thread and getView() writes to
+        // the camera, so the scheduled systems only see the copies below
+        cameraView = triangleCamera->getView();
+        cameraProj = glm::perspective(glm::radians(45.0f), triangleRenderer.getAspectRatio(), cameraNear, cameraFar);
+        cameraProj[1][1] *= -1;
+
+        cameraFrustum = Frustum::fromMatrix(cameraProj * cameraView);
+    }
+
+    void Engine::transformSystem()
+    {
+        // Model matrices only change with their transform or one of its parents
+        uint32_t since = transformTick;
+        transformTick = ecs.advanceTick();
+
+        transformBatch.clear();
+        transformBatchEntities.clear();
+        ecs.view<Transform>().changed<Transform>(since).each([&](Entity entity, Transform& transform)
+        {
+            transformBatch.push_back(transform);
+            transformBatchEntities.push_back(entity);
+        });
+
+        transformBatchMatrices.resize(transformBatch.size());
+        jobSystem.parallelFor(transformBatch.size(), 1024, [&](uint32_t begin, uint32_t end)
+        {
+            composeModelMatrices(transformBatch, begin, end, transformBatchMatrices.data());
+        });
+
+        for (uint32_t i = 0; i < transformBatchEntities.size(); ++i)
+            transformHierarchy.setLocal(transformBatchEntities[i], transformBatchMatrices[i]);
+
+        transformHierarchy.update(jobSystem, 256);
+
+        transformHierarchy.eachUpdated([this](const Entity& entity, const glm::mat4&)
+        {
+            ecs.markChanged<RenderModel>(entity);
+        });
+    }
+
+    void Engine::meshSystem()
+    {
+        // Only RenderModels assigned or changed since the last check can
+        // bring a mesh that is not uploaded yet
+        uint32_t since = meshTick;
+        meshTick = ecs.advanceTick();
+
+        // Meshes shared by several entities are uploaded once
+        std::vector<const Mesh*> newMeshes;
+        ecs.view<RenderModel>().changed<RenderModel>(since).each([&](Entity, RenderModel& component)
+        {
+            uint32_t index = triangleModel->getMeshCount() + static_cast<uint32_t>(newMeshes.size());
+            if (meshIndices.emplace(component.mesh.id, index).second)
+                newMeshes.push_back(&component.mesh);
+        });
+
+        if (newMeshes.empty())
+            return;
+
+        // Cached command buffers refer to the previous buffers
+        if (triangleModel->appendMeshes(newMeshes))
+            ++commandCacheGeneration;
     }
 }
\ No newline at end of file
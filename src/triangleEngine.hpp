@@ -10,8 +10,18 @@
 #include "triangleDescriptor.hpp"
 #include "triangleTypes.hpp"
 #include "triangleECS.hpp"
+#include "triangleScheduler.hpp"
+#include "triangleJobSystem.hpp"
+#include "triangleEntityCommands.hpp"
+#include "triangleHierarchy.hpp"
+#include "triangleTransformKernels.hpp"
+#include "triangleGpuCulling.hpp"
+#include "triangleCullingKernels.hpp"
+#include "triangleRenderQueue.hpp"
 
+#include <array>
 #include <memory>
+#include <unordered_map>
 #include <vector>
 
 using Index = uint32_t;
@@ -106,14 +116,160 @@ namespace triangle
         // };
 
         uint32_t currentFrame = 0, imageIndex;
-        vk::DeviceSize dynamicOffset = 0;
+        static constexpr float cameraNear = 0.1f, cameraFar = 20.0f;
         glm::vec3 cameraPos = glm::vec3(0.f, 0.f, 2.f);
+        glm::mat4 cameraView, cameraProj;
+        // Planes of cameraProj * cameraView, set by cameraSystem
+        Frustum cameraFrustum;
+
+        // ECS tick of the last model matrix rebuild
+        uint32_t transformTick = 0;
+
+        // State shared by scheduled systems besides components, declared in
+        // their reads / writes through Scheduler::resource()
+        enum class SystemResource : uint32_t
+        {
+            Hierarchy,
+            Tick,
+            DrawList,
+            Count
+        };
+
+        static Signature resource(SystemResource resource)
+        {
+            using World = decltype(ecs);
+            static_assert(static_cast<uint32_t>(SystemResource::Count) <= maxComponents - World::Registry::count,
+                          "system resources collide with component ids");
+            return Scheduler::resource<World>(static_cast<uint32_t>(resource));
+        }
 
         Window triangleWindow{WIDTH, HEIGHT, "Vulkan"};
         Device triangleDevice{"vulkan basic", triangleWindow};
         Pipeline trianglePipeline{triangleDevice};
         Renderer triangleRenderer{triangleDevice, triangleWindow};
-        ECS ecs;
+        ECS<RenderModel, Transform> ecs;
+        JobSystem jobSystem;
+        Scheduler scheduler{jobSystem};
+
+        // Structural changes recorded by systems, applied before the next
+        // scheduler run so every system of a frame sees the same entities
+        ThreadEntityCommandBuffers<RenderModel, Transform> entityCommands{jobSystem};
+        TransformHierarchy transformHierarchy;
+
+        // Changed transforms gathered by transformSystem for the batch kernels, kept
+        // between frames to reuse their memory
+        TransformSoA transformBatch;
+        std::vector<Entity> transformBatchEntities;
+        std::vector<glm::mat4> transformBatchMatrices;
+
+        // Entities with a RenderModel, sorted each frame through renderQueue
+        // and grouped into one instanced draw per (pipeline, mesh). Kept
+        // between frames to reuse their memory.
+        struct InstanceDraw
+        {
+            const Material* material;
+            uint32_t pipeline, mesh;
+            Entity entity;
+        };
+
+        struct DrawGroup
+        {
+            const Material* material;
+            uint32_t mesh, firstInstance, instanceCount;
+        };
+
+        // Consecutive groups sharing a pipeline
+        struct DrawRun
+        {
+            const Material* material;
+            uint32_t firstGroup, groupCount;
+        };
+
+        // State changes and draw calls recorded by the last renderSystem
+        struct RenderStats
+        {
+            uint32_t draws, pipelineBinds, descriptorBinds;
+        };
+
+        std::vector<InstanceDraw> instanceDraws;
+        RenderQueue renderQueue;
+        std::vector<DrawGroup> drawGroups;
+        std::vector<DrawRun> drawRuns;
+        RenderStats renderStats{};
+
+        // Contiguous slices of the sorted draws, each recorded by a worker
+        // into its own secondary command buffer and executed in slice order
+        struct RecordSlice
+        {
+            vk::CommandBuffer commandBuffer;
+            RenderStats stats;
+            bool reused;
+        };
+
+        static constexpr uint32_t minDrawsPerSlice = 64;
+        bool useSecondaryCommandBuffers = true;
+        std::vector<RecordSlice> recordSlices;
+        std::vector<vk::CommandBuffer> secondaryCommandBuffers;
+
+        // Everything a recorded draw command depends on besides the frame's
+        // descriptor set: a draw group, or a pipeline run with GPU culling
+        struct RecordedDraw
+        {
+            vk::Pipeline pipeline;
+            vk::PipelineLayout pipelineLayout;
+            uint32_t mesh, first, count;
+            bool indirect;
+
+            bool operator==(const RecordedDraw&) const = default;
+        };
+
+        // Slices recorded into the renderer's cached slots, [frame][slice].
+        // A slice whose draws and generation match is executed again as is,
+        // so static scenes skip recording entirely.
+        struct CachedSlice
+        {
+            std::vector<RecordedDraw> draws;
+            uint64_t generation = 0;
+            vk::CommandBuffer commandBuffer;
+            RenderStats stats;
+        };
+
+        bool useCommandCache = true;
+        std::vector<RecordedDraw> recordedDraws;
+        std::array<std::vector<CachedSlice>, Swapchain::MAX_FRAMES_IN_FLIGHT> cachedSlices;
+
+        // Bumped when buffers referenced by recorded commands are recreated
+        uint32_t commandCacheGeneration = 1;
+
+        // Tick of the last upload into each frame's object buffer, 0 uploads everything
+        std::array<uint32_t, Swapchain::MAX_FRAMES_IN_FLIGHT> objectUploadTicks{};
+
+        // World matrix of every entry of instanceDraws, and for CPU culling
+        // their world bounds and whether they passed the frustum test
+        std::vector<glm::mat4> drawModels;
+        BoundsSoA cullBounds;
+        std::vector<uint8_t> drawVisibility;
+        bool useCpuCulling = true;
+
+        // Draws tested by the culling path in use and how many passed. The
+        // GPU path reads its counts back once the frame's fence signaled.
+        struct CullStats
+        {
+            uint32_t tested, visible;
+        };
+
+        CullStats cullStats{};
+
+        // Null when the cull shader could not be loaded
+        std::unique_ptr<GpuCulling> gpuCulling;
+        bool useGpuCulling = false;
+        std::vector<GpuCulling::Object> cullObjects;
+        std::vector<GpuCulling::DrawCommand> cullDraws;
+
+        // Index in the shared vertex and index buffers of each uploaded
+        // Mesh::id. Meshes stay uploaded once no RenderModel uses them.
+        std::unordered_map<uint32_t, uint32_t> meshIndices;
+        uint32_t meshTick = 0;
 
         // vk::PipelineLayout pipelineLayout;
 
@@ -124,12 +280,33 @@ namespace triangle
         std::vector<vk::PipelineLayout> layouts;
         std::vector<vk::Pipeline> pipelines;
 
+        // Position of the pipeline in pipelines, used as its sort key id
+        uint32_t getPipelineID(vk::Pipeline pipeline);
+
         vk::PipelineLayout createPipelineLayout();
         void createPipeline(Pipeline::PipelineConfig& pipelineConfig);
 
-        void initSceneSystem();
-        void mvpSystem(uint32_t currentImage);
+        // Appends the meshes of new RenderModels that are not in the shared
+        // vertex and index buffers yet
+        void meshSystem();
+
+        // Updates the camera matrices and frustum on the main thread, before
+        // the scheduled systems that read them run
+        void cameraSystem();
+        void transformSystem();
+        void cullSystem();
+
+        // Uploads the changed objects into the frame's object buffer, then
+        // fills its instance buffer from the draws sorted by cullSystem, or
+        // records the GPU culling pass that does. Runs once the frame's fence
+        // has been waited on.
+        void instanceSystem(uint32_t currentImage, vk::CommandBuffer &currentCommandBuffer);
         void renderSystem(uint32_t currentImage, vk::CommandBuffer &currentCommandBuffer);
+
+        // Records draws [begin, end): pipeline runs with GPU culling, draw
+        // groups otherwise. Binds all the state it needs, so it can start a
+        // fresh secondary command buffer.
+        void recordDraws(vk::CommandBuffer &commandBuffer, uint32_t currentImage, uint32_t begin, uint32_t end, RenderStats &stats);
         void initEntities();
 
         void drawUI();
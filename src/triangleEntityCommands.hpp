@@ -0,0 +1,233 @@
+#pragma once
+
+#include "triangleECS.hpp"
+#include "triangleJobSystem.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace triangle
+{
+	// Records structural changes (entity creation/deletion, component
+	// assignment/removal) so systems can issue them while iterating and have
+	// them applied later at a sync point with flush().
+	//
+	// Entities created through the buffer are returned as pending handles
+	// (generation 0, which no live entity uses). They can be passed back to the
+	// same buffer and are mapped to real entities when the buffer is flushed.
+	//
+	// flush() applies everything in fixed phases rather than in recording order:
+	// creations, then component assignments, then component removals, then
+	// entity deletions. Within a phase records are sorted by entity id so each
+	// pool is filled in one pass.
+	template <typename... Components>
+	class EntityCommandBuffer
+	{
+	public:
+		using World = ECS<Components...>;
+
+		static bool isPending(const Entity& a_Entity) { return a_Entity.generation == 0 && a_Entity.id != 0; }
+
+		bool empty() const
+		{
+			return m_PendingCount == 0 && m_Deletions.empty()
+				&& (std::get<Assignments<Components>>(m_Assignments).entities.empty() && ...)
+				&& std::all_of(m_Removals.begin(), m_Removals.end(), [](const auto& a_Removals) { return a_Removals.empty(); });
+		}
+
+		Entity addEntity() { return Entity{++m_PendingCount, 0}; }
+
+		void deleteEntity(const Entity& a_Entity) { m_Deletions.push_back(a_Entity); }
+
+		template <typename T>
+		void assignComponent(const Entity& a_Entity, const T& a_Component)
+		{
+			auto& assignments = std::get<Assignments<T>>(m_Assignments);
+			assignments.entities.push_back(a_Entity);
+			assignments.components.push_back(a_Component);
+		}
+
+		template <typename T>
+		void deleteComponent(const Entity& a_Entity)
+		{
+			m_Removals[World::template componentID<T>()].push_back(a_Entity);
+		}
+
+		// Must not run concurrently with anything touching a_World. Returns
+		// the number of entities deleted, for state kept outside the ECS.
+		uint32_t flush(World& a_World)
+		{
+			resolve(a_World);
+			return apply(a_World);
+		}
+
+		void clear()
+		{
+			m_PendingCount = 0;
+			m_Created.clear();
+			m_Deletions.clear();
+			((std::get<Assignments<Components>>(m_Assignments).entities.clear(),
+			  std::get<Assignments<Components>>(m_Assignments).components.clear()), ...);
+			for (auto& removals : m_Removals)
+				removals.clear();
+		}
+
+	private:
+		template <typename... Ts>
+		friend class ThreadEntityCommandBuffers;
+
+		template <typename T>
+		struct Assignments
+		{
+			std::vector<Entity> entities;
+			std::vector<T> components;
+		};
+
+		uint32_t m_PendingCount = 0;
+
+		// Real entities created for the pending handles, filled by resolve()
+		std::vector<Entity> m_Created;
+
+		std::vector<Entity> m_Deletions;
+		std::tuple<Assignments<Components>...> m_Assignments;
+		std::array<std::vector<Entity>, sizeof...(Components)> m_Removals;
+
+		// Order in which a batch of records is applied: by entity id, ties keep
+		// recording order. Components holding references cannot be swapped, so
+		// the indices are sorted rather than the records.
+		static std::vector<uint32_t> sortedOrder(const std::vector<Entity>& a_Entities)
+		{
+			std::vector<uint32_t> order(a_Entities.size());
+			for (uint32_t i = 0; i < order.size(); ++i)
+				order[i] = i;
+
+			std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b)
+				{ return a_Entities[a].id < a_Entities[b].id; });
+
+			return order;
+		}
+
+		Entity map(const Entity& a_Entity) const
+		{
+			return isPending(a_Entity) ? m_Created[a_Entity.id - 1] : a_Entity;
+		}
+
+		// Creates the pending entities and rewrites every record to real handles
+		void resolve(World& a_World)
+		{
+			m_Created.clear();
+			m_Created.reserve(m_PendingCount);
+			for (uint32_t i = 0; i < m_PendingCount; ++i)
+				m_Created.push_back(a_World.addEntity());
+
+			for (auto& entity : m_Deletions)
+				entity = map(entity);
+
+			((resolveAll(std::get<Assignments<Components>>(m_Assignments).entities)), ...);
+			for (auto& removals : m_Removals)
+				resolveAll(removals);
+
+			m_PendingCount = 0;
+		}
+
+		void resolveAll(std::vector<Entity>& a_Entities)
+		{
+			for (auto& entity : a_Entities)
+				entity = map(entity);
+		}
+
+		// Moves the resolved records of a_Other to the end of this buffer
+		void append(EntityCommandBuffer& a_Other)
+		{
+			m_Deletions.insert(m_Deletions.end(), a_Other.m_Deletions.begin(), a_Other.m_Deletions.end());
+
+			((appendAssignments(std::get<Assignments<Components>>(m_Assignments), std::get<Assignments<Components>>(a_Other.m_Assignments))), ...);
+
+			for (size_t i = 0; i < m_Removals.size(); ++i)
+				m_Removals[i].insert(m_Removals[i].end(), a_Other.m_Removals[i].begin(), a_Other.m_Removals[i].end());
+
+			a_Other.clear();
+		}
+
+		template <typename T>
+		static void appendAssignments(Assignments<T>& a_Dst, Assignments<T>& a_Src)
+		{
+			a_Dst.entities.insert(a_Dst.entities.end(), a_Src.entities.begin(), a_Src.entities.end());
+			for (auto& component : a_Src.components)
+				a_Dst.components.push_back(std::move(component));
+		}
+
+		// Expects resolve() to have run
+		uint32_t apply(World& a_World)
+		{
+			(applyAssignments(a_World, std::get<Assignments<Components>>(m_Assignments)), ...);
+			(applyRemovals<Components>(a_World), ...);
+
+			uint32_t deletedCount = 0;
+			for (uint32_t index : sortedOrder(m_Deletions))
+			{
+				Entity entity = m_Deletions[index];
+				deletedCount += a_World.deleteEntity(entity) ? 1 : 0;
+			}
+
+			clear();
+
+			return deletedCount;
+		}
+
+		template <typename T>
+		static void applyAssignments(World& a_World, Assignments<T>& a_Assignments)
+		{
+			for (uint32_t index : sortedOrder(a_Assignments.entities))
+				a_World.assignComponent(a_Assignments.entities[index], a_Assignments.components[index]);
+		}
+
+		template <typename T>
+		void applyRemovals(World& a_World)
+		{
+			const auto& removals = m_Removals[World::template componentID<T>()];
+			for (uint32_t index : sortedOrder(removals))
+				a_World.template deleteComponent<T>(removals[index]);
+		}
+	};
+
+	// One EntityCommandBuffer per job system thread, so systems running in
+	// parallel can record without locking. Threads outside the job system share
+	// one extra buffer and must not record concurrently.
+	template <typename... Components>
+	class ThreadEntityCommandBuffers
+	{
+	public:
+		using Buffer = EntityCommandBuffer<Components...>;
+
+		ThreadEntityCommandBuffers(const JobSystem& a_JobSystem)
+			: m_JobSystem{a_JobSystem}, m_Buffers(a_JobSystem.getWorkerCount() + 1) {}
+
+		// Buffer of the calling thread. Pending handles it returns are only
+		// meaningful to that same buffer.
+		Buffer& local() { return m_Buffers[m_JobSystem.getCurrentWorkerIndex()]; }
+
+		// Creates the pending entities of every buffer, then applies all records
+		// as a single sorted batch. Returns the number of entities deleted.
+		uint32_t flush(ECS<Components...>& a_World)
+		{
+			Buffer& merged = m_Buffers.front();
+			for (auto& buffer : m_Buffers)
+				buffer.resolve(a_World);
+
+			for (size_t i = 1; i < m_Buffers.size(); ++i)
+				merged.append(m_Buffers[i]);
+
+			return merged.apply(a_World);
+		}
+
+	private:
+		const JobSystem& m_JobSystem;
+		std::vector<Buffer> m_Buffers;
+	};
+}
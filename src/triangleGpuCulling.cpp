@@ -0,0 +1,198 @@
+#include "triangleGpuCulling.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+namespace triangle
+{
+    GpuCulling::GpuCulling(Device &device, Pipeline &trianglePipeline, uint32_t frameCount)
+        : device{device}
+    {
+        std::array<vk::DescriptorSetLayoutBinding, 6> bindings;
+        for (uint32_t i = 0; i < bindings.size(); ++i)
+            bindings[i] = vk::DescriptorSetLayoutBinding(i, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute, nullptr);
+
+        descriptorSetLayout = device.getLogicalDevice().createDescriptorSetLayout(
+            vk::DescriptorSetLayoutCreateInfo(vk::DescriptorSetLayoutCreateFlags(), bindings));
+
+        vk::PushConstantRange pushConstantRange(vk::ShaderStageFlagBits::eCompute, 0, sizeof(CullParameters));
+        pipelineLayout = device.getLogicalDevice().createPipelineLayout(
+            vk::PipelineLayoutCreateInfo(vk::PipelineLayoutCreateFlags(), descriptorSetLayout, pushConstantRange));
+
+        const char* shaderPath = "../shaders/spv/cullComp.spv";
+        try
+        {
+            pipeline = trianglePipeline.createComputePipeline(pipelineLayout, shaderPath);
+        }
+        catch (const std::exception& error)
+        {
+            device.getLogicalDevice().destroyPipelineLayout(pipelineLayout);
+            device.getLogicalDevice().destroyDescriptorSetLayout(descriptorSetLayout);
+            throw std::runtime_error(std::string(error.what()) + ": " + shaderPath);
+        }
+
+        createDescriptorSets(frameCount);
+    }
+
+    GpuCulling::~GpuCulling()
+    {
+        for (auto& frame : frames)
+        {
+            destroy(frame.objects);
+            destroy(frame.draws);
+            destroy(frame.visibleDraws);
+            destroy(frame.counts);
+        }
+
+        device.getLogicalDevice().destroyPipeline(pipeline);
+        device.getLogicalDevice().destroyPipelineLayout(pipelineLayout);
+        device.getLogicalDevice().destroyDescriptorPool(descriptorPool);
+        device.getLogicalDevice().destroyDescriptorSetLayout(descriptorSetLayout);
+    }
+
+    void GpuCulling::createDescriptorSets(uint32_t frameCount)
+    {
+        vk::DescriptorPoolSize poolSize(vk::DescriptorType::eStorageBuffer, frameCount * 6);
+        descriptorPool = device.getLogicalDevice().createDescriptorPool(
+            vk::DescriptorPoolCreateInfo(vk::DescriptorPoolCreateFlags(), frameCount, poolSize));
+
+        std::vector<vk::DescriptorSetLayout> layouts(frameCount, descriptorSetLayout);
+        std::vector<vk::DescriptorSet> descriptorSets = device.getLogicalDevice().allocateDescriptorSets(
+            vk::DescriptorSetAllocateInfo(descriptorPool, layouts));
+
+        frames.resize(frameCount);
+        for (uint32_t i = 0; i < frameCount; ++i)
+            frames[i].descriptorSet = descriptorSets[i];
+    }
+
+    void GpuCulling::reserve(MappedBuffer &buffer, vk::DeviceSize size, vk::BufferUsageFlags usage)
+    {
+        // Storage buffers cannot be bound with a zero range
+        size = std::max<vk::DeviceSize>(size, 16);
+        if (size <= buffer.size)
+            return;
+
+        destroy(buffer);
+
+        vk::MemoryPropertyFlags memoryProperty(vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+        device.createBuffer(size, usage, memoryProperty, buffer.buffer, buffer.memory);
+
+        buffer.mapping = device.getLogicalDevice().mapMemory(buffer.memory, 0, VK_WHOLE_SIZE);
+        buffer.size = size;
+        ++bufferGeneration;
+    }
+
+    void GpuCulling::destroy(MappedBuffer &buffer)
+    {
+        if (!buffer.buffer)
+            return;
+
+        device.getLogicalDevice().unmapMemory(buffer.memory);
+        device.getLogicalDevice().destroyBuffer(buffer.buffer);
+        device.getLogicalDevice().freeMemory(buffer.memory);
+
+        buffer = MappedBuffer{};
+    }
+
+    void GpuCulling::record(vk::CommandBuffer &commandBuffer, uint32_t frameIndex, const Frustum &frustum,
+                            const std::vector<Object> &objects, const std::vector<DrawCommand> &draws, uint32_t runCount,
+                            vk::Buffer objectBuffer, vk::Buffer instanceBuffer)
+    {
+        FrameResources& frame = frames[frameIndex];
+
+        // The fence of this frame has signaled, the counts of its last use are final
+        if (frame.counts.mapping)
+        {
+            visibleCount = static_cast<const uint32_t*>(frame.counts.mapping)[0];
+            testedCount = frame.objectCount;
+        }
+        frame.objectCount = static_cast<uint32_t>(objects.size());
+
+        // The frame's buffers are not in use by the GPU, growing them is safe
+        vk::BufferUsageFlags indirectUsage = vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer;
+        reserve(frame.objects, sizeof(Object) * objects.size(), vk::BufferUsageFlagBits::eStorageBuffer);
+        reserve(frame.draws, sizeof(DrawCommand) * draws.size(), indirectUsage);
+        reserve(frame.visibleDraws, sizeof(DrawCommand) * draws.size(), indirectUsage);
+        reserve(frame.counts, sizeof(uint32_t) * (1 + runCount), indirectUsage);
+
+        if (!objects.empty())
+            std::memcpy(frame.objects.mapping, objects.data(), sizeof(Object) * objects.size());
+
+        DrawCommand* mappedDraws = static_cast<DrawCommand*>(frame.draws.mapping);
+        for (uint32_t i = 0; i < draws.size(); ++i)
+        {
+            mappedDraws[i] = draws[i];
+            mappedDraws[i].instanceCount = 0;
+        }
+
+        std::memset(frame.counts.mapping, 0, sizeof(uint32_t) * (1 + runCount));
+
+        // Rewritten every frame, buffers may have been recreated above
+        std::array<vk::DescriptorBufferInfo, 6> bufferInfos = {
+            vk::DescriptorBufferInfo(frame.objects.buffer, 0, VK_WHOLE_SIZE),
+            vk::DescriptorBufferInfo(frame.draws.buffer, 0, VK_WHOLE_SIZE),
+            vk::DescriptorBufferInfo(frame.visibleDraws.buffer, 0, VK_WHOLE_SIZE),
+            vk::DescriptorBufferInfo(frame.counts.buffer, 0, VK_WHOLE_SIZE),
+            vk::DescriptorBufferInfo(instanceBuffer, 0, VK_WHOLE_SIZE),
+            vk::DescriptorBufferInfo(objectBuffer, 0, VK_WHOLE_SIZE)};
+
+        std::array<vk::WriteDescriptorSet, 6> descriptorWrites;
+        for (uint32_t i = 0; i < descriptorWrites.size(); ++i)
+            descriptorWrites[i] = vk::WriteDescriptorSet(frame.descriptorSet, i, 0, vk::DescriptorType::eStorageBuffer, {}, bufferInfos[i]);
+
+        device.getLogicalDevice().updateDescriptorSets(descriptorWrites, nullptr);
+
+        commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, pipeline);
+        commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, pipelineLayout, 0, frame.descriptorSet, nullptr);
+
+        CullParameters parameters{};
+        parameters.planes = frustum.planes;
+        parameters.objectCount = static_cast<uint32_t>(objects.size());
+        parameters.drawCount = static_cast<uint32_t>(draws.size());
+
+        vk::MemoryBarrier computeBarrier(vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+
+        parameters.phase = 0;
+        commandBuffer.pushConstants<CullParameters>(pipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, parameters);
+        commandBuffer.dispatch((parameters.objectCount + 63) / 64, 1, 1);
+
+        // Without the count variant the draws buffer is drawn as is, zero
+        // instance draws included, and compaction is not needed
+        if (device.supportsDrawIndirectCount())
+        {
+            commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader,
+                                          vk::DependencyFlags(), computeBarrier, nullptr, nullptr);
+
+            parameters.phase = 1;
+            commandBuffer.pushConstants<CullParameters>(pipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, parameters);
+            commandBuffer.dispatch((parameters.drawCount + 63) / 64, 1, 1);
+        }
+
+        vk::MemoryBarrier drawBarrier(vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eIndirectCommandRead | vk::AccessFlagBits::eShaderRead);
+        commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eDrawIndirect | vk::PipelineStageFlagBits::eVertexShader,
+                                      vk::DependencyFlags(), drawBarrier, nullptr, nullptr);
+    }
+
+    void GpuCulling::drawRun(vk::CommandBuffer &commandBuffer, uint32_t frameIndex, uint32_t run, uint32_t firstDraw, uint32_t drawCount)
+    {
+        FrameResources& frame = frames[frameIndex];
+        vk::DeviceSize offset = sizeof(DrawCommand) * firstDraw;
+
+        if (device.supportsDrawIndirectCount())
+        {
+            commandBuffer.drawIndexedIndirectCount(frame.visibleDraws.buffer, offset, frame.counts.buffer, sizeof(uint32_t) * (1 + run),
+                                                   drawCount, sizeof(DrawCommand));
+        }
+        else if (device.supportsMultiDrawIndirect())
+        {
+            commandBuffer.drawIndexedIndirect(frame.draws.buffer, offset, drawCount, sizeof(DrawCommand));
+        }
+        else
+        {
+            for (uint32_t i = 0; i < drawCount; ++i)
+                commandBuffer.drawIndexedIndirect(frame.draws.buffer, offset + sizeof(DrawCommand) * i, 1, sizeof(DrawCommand));
+        }
+    }
+}
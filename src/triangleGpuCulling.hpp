@@ -0,0 +1,115 @@
+#pragma once
+
+#include "triangleDevice.hpp"
+#include "trianglePipeline.hpp"
+#include "triangleTypes.hpp"
+
+#include <vulkan/vulkan.hpp>
+#include <glm/glm.hpp>
+
+#include <array>
+#include <vector>
+
+namespace triangle
+{
+    // Frustum culling on the GPU. A compute pass tests the bounding sphere of
+    // every object, writes the object slots of the survivors into the
+    // instance buffer and, when drawIndexedIndirectCount is available,
+    // compacts the non-empty draws of each pipeline run. The draws are then
+    // issued with drawIndexedIndirect(Count) from inside the render pass.
+    class GpuCulling
+    {
+    public:
+        // Mirrors CullObject in cullShader.comp (std430)
+        // slot indexes the object buffer that holds the model matrix.
+        struct Object
+        {
+            uint32_t slot, draw;
+            uint32_t padding[2];
+            glm::vec4 boundingSphere;
+        };
+
+        // Mirrors DrawCommand in cullShader.comp. Starts with the fields of
+        // VkDrawIndexedIndirectCommand, the whole struct is the indirect stride.
+        // Draws of one run share a pipeline and are contiguous, run numbers
+        // start at 0 and runFirstDraw is the index of the run's first draw.
+        struct DrawCommand
+        {
+            uint32_t indexCount, instanceCount, firstIndex;
+            int32_t vertexOffset;
+            uint32_t firstInstance;
+            uint32_t run, runFirstDraw, padding;
+        };
+
+        static_assert(sizeof(Object) == 32, "Object must match the std430 layout of CullObject");
+        static_assert(sizeof(DrawCommand) == 32, "DrawCommand must match the std430 layout of the shader's DrawCommand");
+
+        // Throws std::runtime_error if the compute shader cannot be loaded
+        GpuCulling(Device& device, Pipeline& trianglePipeline, uint32_t frameCount);
+        ~GpuCulling();
+
+        GpuCulling(const GpuCulling&) = delete;
+        GpuCulling& operator=(const GpuCulling&) = delete;
+
+        // Uploads the objects and draws of this frame and records the compute
+        // dispatches, followed by a barrier for the indirect and vertex input
+        // stages. Must be recorded outside a render pass, once the frame's
+        // fence has signaled. Instance counts of the draws are ignored.
+        void record(vk::CommandBuffer& commandBuffer, uint32_t frame, const Frustum& frustum,
+                    const std::vector<Object>& objects, const std::vector<DrawCommand>& draws, uint32_t runCount,
+                    vk::Buffer objectBuffer, vk::Buffer instanceBuffer);
+
+        // Draws [firstDraw, firstDraw + drawCount) of the frame, which must all
+        // belong to run. Pipeline, descriptors and vertex buffers are expected
+        // to be bound already.
+        void drawRun(vk::CommandBuffer& commandBuffer, uint32_t frame, uint32_t run, uint32_t firstDraw, uint32_t drawCount);
+
+        // Instances that passed the test the last time the frame's buffers
+        // were used, out of getTestedCount() objects, read back by record()
+        uint32_t getVisibleCount() { return visibleCount; }
+        uint32_t getTestedCount() { return testedCount; }
+
+        // Bumped whenever a buffer that drawRun records a reference to is
+        // recreated, command buffers recorded before that are stale
+        uint32_t getBufferGeneration() { return bufferGeneration; }
+
+    private:
+        struct CullParameters
+        {
+            std::array<glm::vec4, 6> planes;
+            uint32_t objectCount, drawCount, phase, padding;
+        };
+
+        struct MappedBuffer
+        {
+            vk::Buffer buffer = VK_NULL_HANDLE;
+            vk::DeviceMemory memory;
+            void* mapping = nullptr;
+            vk::DeviceSize size = 0;
+        };
+
+        struct FrameResources
+        {
+            MappedBuffer objects, draws, visibleDraws, counts;
+            vk::DescriptorSet descriptorSet;
+            // Objects dispatched the last time, what counts is out of
+            uint32_t objectCount = 0;
+        };
+
+        Device& device;
+
+        vk::DescriptorSetLayout descriptorSetLayout;
+        vk::DescriptorPool descriptorPool;
+        vk::PipelineLayout pipelineLayout;
+        vk::Pipeline pipeline;
+
+        std::vector<FrameResources> frames;
+        uint32_t visibleCount = 0, testedCount = 0, bufferGeneration = 0;
+
+        void createDescriptorSets(uint32_t frameCount);
+
+        // Recreates the buffer when it is smaller than size, keeps it otherwise
+        void reserve(MappedBuffer& buffer, vk::DeviceSize size, vk::BufferUsageFlags usage);
+        void destroy(MappedBuffer& buffer);
+    };
+}
@@ -0,0 +1,325 @@
+#include "triangleHierarchy.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <type_traits>
+#include <utility>
+
+namespace triangle
+{
+    bool TransformHierarchy::contains(const Entity& entity) const
+    {
+        return find(entity) != npos;
+    }
+
+    void TransformHierarchy::setLocal(const Entity& entity, const glm::mat4& local)
+    {
+        uint32_t node = findOrAdd(entity);
+        locals[node] = local;
+        markDirty(node);
+    }
+
+    bool TransformHierarchy::setParent(const Entity& child, const Entity& parent)
+    {
+        if (parent.id != 0)
+        {
+            if (!contains(parent) && parent.id < sparse.size() && sparse[parent.id] != npos)
+                return false;
+
+            findOrAdd(parent);
+
+            for (uint32_t ancestor = find(parent); ancestor != npos; ancestor = find(parentEntities[ancestor]))
+            {
+                if (entities[ancestor] == child)
+                    return false;
+            }
+        }
+
+        uint32_t node = findOrAdd(child);
+        parentEntities[node] = parent;
+        localDirty[node] = 1;
+        orderDirty = true;
+
+        return true;
+    }
+
+    bool TransformHierarchy::remove(const Entity& entity)
+    {
+        uint32_t node = find(entity);
+        if (node == npos)
+            return false;
+
+        for (uint32_t i = 0; i < entities.size(); ++i)
+        {
+            if (parentEntities[i] == entity)
+            {
+                parentEntities[i] = parentEntities[node];
+                localDirty[i] = 1;
+            }
+        }
+
+        uint32_t last = static_cast<uint32_t>(entities.size() - 1);
+        if (node != last)
+        {
+            entities[node] = entities[last];
+            parentEntities[node] = parentEntities[last];
+            locals[node] = locals[last];
+            worlds[node] = worlds[last];
+            localDirty[node] = localDirty[last];
+            updated[node] = updated[last];
+            sparse[entities[node].id] = node;
+        }
+
+        entities.pop_back();
+        parentEntities.pop_back();
+        parents.resize(entities.size());
+        locals.pop_back();
+        worlds.pop_back();
+        localDirty.pop_back();
+        updated.pop_back();
+        sparse[entity.id] = npos;
+
+        orderDirty = true;
+        levelUpdated.clear();
+
+        return true;
+    }
+
+    const glm::mat4* TransformHierarchy::getWorld(const Entity& entity) const
+    {
+        uint32_t node = find(entity);
+        return node == npos ? nullptr : &worlds[node];
+    }
+
+    void TransformHierarchy::update(JobSystem& jobSystem, uint32_t grainSize)
+    {
+        if (orderDirty)
+            rebuildOrder();
+
+        for (uint32_t level = 0; level < getLevelCount(); ++level)
+        {
+            if (levelUpdated[level])
+                std::fill(updated.begin() + levelOffsets[level], updated.begin() + levelOffsets[level + 1], 0);
+            levelUpdated[level] = 0;
+        }
+
+        for (uint32_t level = 0; level < getLevelCount(); ++level)
+        {
+            // Nothing on this level can change without a dirty local matrix
+            // or a parent that was just updated
+            if (!levelDirty[level] && (level == 0 || !levelUpdated[level - 1]))
+                continue;
+
+            uint32_t begin = levelOffsets[level];
+            uint32_t end = levelOffsets[level + 1];
+            std::atomic<bool> anyUpdated{false};
+
+            // Parents live in earlier levels, which are already final
+            jobSystem.parallelFor(end - begin, grainSize, [&](uint32_t first, uint32_t last)
+            {
+                bool chunkUpdated = false;
+                for (uint32_t node = begin + first; node < begin + last; ++node)
+                {
+                    uint32_t parent = parents[node];
+                    if (!localDirty[node] && (parent == npos || !updated[parent]))
+                        continue;
+
+                    worlds[node] = parent == npos ? locals[node] : worlds[parent] * locals[node];
+                    localDirty[node] = 0;
+                    updated[node] = 1;
+                    chunkUpdated = true;
+                }
+
+                if (chunkUpdated)
+                    anyUpdated.store(true, std::memory_order_relaxed);
+            });
+
+            levelDirty[level] = 0;
+            levelUpdated[level] = anyUpdated.load(std::memory_order_relaxed);
+        }
+    }
+
+    uint32_t TransformHierarchy::find(const Entity& entity) const
+    {
+        if (entity.id >= sparse.size() || sparse[entity.id] == npos)
+            return npos;
+
+        uint32_t node = sparse[entity.id];
+        return entities[node] == entity ? node : npos;
+    }
+
+    uint32_t TransformHierarchy::findOrAdd(const Entity& entity)
+    {
+        uint32_t node = find(entity);
+        if (node != npos)
+            return node;
+
+        // A stale handle for the same slot is replaced
+        if (entity.id < sparse.size() && sparse[entity.id] != npos)
+            remove(entities[sparse[entity.id]]);
+
+        if (entity.id >= sparse.size())
+            sparse.resize(entity.id + 1, npos);
+
+        node = static_cast<uint32_t>(entities.size());
+        sparse[entity.id] = node;
+
+        entities.push_back(entity);
+        parentEntities.push_back(Entity{});
+        parents.push_back(npos);
+        locals.push_back(glm::mat4{1.0f});
+        worlds.push_back(glm::mat4{1.0f});
+        localDirty.push_back(1);
+        updated.push_back(0);
+
+        orderDirty = true;
+
+        return node;
+    }
+
+    void TransformHierarchy::markDirty(uint32_t node)
+    {
+        localDirty[node] = 1;
+
+        // rebuildOrder() recomputes the dirty levels from scratch
+        if (orderDirty)
+            return;
+
+        uint32_t level = static_cast<uint32_t>(std::upper_bound(levelOffsets.begin() + 1, levelOffsets.end(), node) - (levelOffsets.begin() + 1));
+        levelDirty[level] = 1;
+    }
+
+    void TransformHierarchy::removeNodes(const std::vector<uint8_t>& removed)
+    {
+        // Reattach first, while every parent can still be looked up
+        for (uint32_t i = 0; i < entities.size(); ++i)
+        {
+            if (removed[i])
+                continue;
+
+            Entity parent = parentEntities[i];
+            for (uint32_t node = find(parent); node != npos && removed[node]; node = find(parent))
+                parent = parentEntities[node];
+
+            if (!(parent == parentEntities[i]))
+            {
+                parentEntities[i] = parent;
+                localDirty[i] = 1;
+            }
+        }
+
+        uint32_t count = 0;
+        for (uint32_t i = 0; i < entities.size(); ++i)
+        {
+            if (removed[i])
+            {
+                sparse[entities[i].id] = npos;
+                continue;
+            }
+
+            entities[count] = entities[i];
+            parentEntities[count] = parentEntities[i];
+            locals[count] = locals[i];
+            worlds[count] = worlds[i];
+            localDirty[count] = localDirty[i];
+            updated[count] = updated[i];
+            sparse[entities[count].id] = count;
+            ++count;
+        }
+
+        entities.resize(count);
+        parentEntities.resize(count);
+        parents.resize(count);
+        locals.resize(count);
+        worlds.resize(count);
+        localDirty.resize(count);
+        updated.resize(count);
+
+        orderDirty = true;
+        levelUpdated.clear();
+    }
+
+    void TransformHierarchy::rebuildOrder()
+    {
+        uint32_t count = static_cast<uint32_t>(entities.size());
+
+        // Depth of every node, each chain is walked once
+        std::vector<uint32_t> depths(count, npos);
+        std::vector<uint32_t> chain;
+        uint32_t levelCount = 0;
+
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            uint32_t node = i;
+            while (depths[node] == npos && parentEntities[node].id != 0)
+            {
+                // A parent that is no longer in the hierarchy makes the node a root
+                uint32_t parent = find(parentEntities[node]);
+                if (parent == npos)
+                {
+                    parentEntities[node] = Entity{};
+                    break;
+                }
+
+                chain.push_back(node);
+                node = parent;
+            }
+
+            uint32_t depth = depths[node] == npos ? 0 : depths[node];
+            depths[node] = depth;
+
+            while (!chain.empty())
+            {
+                depths[chain.back()] = ++depth;
+                chain.pop_back();
+            }
+
+            levelCount = std::max(levelCount, depth + 1);
+        }
+
+        // Stable counting sort by depth
+        levelOffsets.assign(levelCount + 1, 0);
+        for (uint32_t depth : depths)
+            levelOffsets[depth + 1]++;
+        for (uint32_t level = 0; level < levelCount; ++level)
+            levelOffsets[level + 1] += levelOffsets[level];
+
+        std::vector<uint32_t> newIndices(count);
+        std::vector<uint32_t> cursors(levelOffsets.begin(), levelOffsets.end() - 1);
+        for (uint32_t i = 0; i < count; ++i)
+            newIndices[i] = cursors[depths[i]]++;
+
+        auto permute = [&](auto& values)
+        {
+            std::remove_reference_t<decltype(values)> sorted(values.size());
+            for (uint32_t i = 0; i < count; ++i)
+                sorted[newIndices[i]] = std::move(values[i]);
+            values = std::move(sorted);
+        };
+
+        permute(entities);
+        permute(parentEntities);
+        permute(locals);
+        permute(worlds);
+        permute(localDirty);
+
+        parents.resize(count);
+        for (uint32_t i = 0; i < count; ++i)
+            sparse[entities[i].id] = i;
+        for (uint32_t i = 0; i < count; ++i)
+            parents[i] = parentEntities[i].id == 0 ? npos : find(parentEntities[i]);
+
+        // Nodes moved, so update flags start over and the dirty levels are
+        // recomputed from the nodes
+        updated.assign(count, 0);
+        levelUpdated.assign(levelCount, 0);
+        levelDirty.assign(levelCount, 0);
+        for (uint32_t level = 0; level < levelCount; ++level)
+        {
+            for (uint32_t i = levelOffsets[level]; i < levelOffsets[level + 1] && !levelDirty[level]; ++i)
+                levelDirty[level] = localDirty[i];
+        }
+
+        orderDirty = false;
+    }
+}
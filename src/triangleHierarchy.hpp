@@ -0,0 +1,112 @@
+#pragma once
+
+#include "triangleECS.hpp"
+#include "triangleJobSystem.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+namespace triangle
+{
+    // Parent/child relations between entities and their world matrices.
+    // Nodes are kept in flat arrays sorted by depth, so every parent comes
+    // before its children and world matrices are propagated with one linear
+    // pass per level. Levels without a changed local matrix or an updated
+    // parent are skipped, so a frame where nothing moved costs one check per
+    // level. Parents are full handles, a stale one is treated as no parent.
+    class TransformHierarchy
+    {
+    public:
+        size_t size() const { return entities.size(); }
+        uint32_t getLevelCount() const { return levelOffsets.empty() ? 0 : static_cast<uint32_t>(levelOffsets.size() - 1); }
+
+        bool contains(const Entity& entity) const;
+
+        // Adds the entity as a root if it is not in the hierarchy yet
+        void setLocal(const Entity& entity, const glm::mat4& local);
+
+        // A null parent makes the entity a root. Missing entities are added as
+        // roots first. Fails if parent is a descendant of child, or a stale
+        // handle to a slot the hierarchy holds for a newer entity.
+        bool setParent(const Entity& child, const Entity& parent);
+
+        // Children of the removed entity are attached to its parent
+        bool remove(const Entity& entity);
+
+        // Removes every node whose entity fails isAlive(Entity), e.g. after
+        // entities were deleted from the ECS, in one pass. Children are
+        // attached to their closest remaining ancestor. Returns the number of
+        // removed nodes.
+        template <typename Predicate>
+        uint32_t removeDead(Predicate&& isAlive)
+        {
+            std::vector<uint8_t> removed(entities.size(), 0);
+            uint32_t removedCount = 0;
+            for (uint32_t i = 0; i < entities.size(); ++i)
+            {
+                if (!isAlive(entities[i]))
+                {
+                    removed[i] = 1;
+                    ++removedCount;
+                }
+            }
+
+            if (removedCount > 0)
+                removeNodes(removed);
+
+            return removedCount;
+        }
+
+        // nullptr if the entity is not in the hierarchy. Valid after update().
+        const glm::mat4* getWorld(const Entity& entity) const;
+
+        // Recomputes the world matrix of every node whose local matrix or
+        // ancestors changed since the last call. Each level is split across
+        // the job system in chunks of grainSize nodes.
+        void update(JobSystem& jobSystem, uint32_t grainSize = 256);
+
+        // Calls func(Entity, const glm::mat4& world) for every node whose
+        // world matrix was recomputed by the last update()
+        template <typename Func>
+        void eachUpdated(Func&& func) const
+        {
+            for (uint32_t level = 0; level < levelUpdated.size(); ++level)
+            {
+                if (!levelUpdated[level])
+                    continue;
+
+                for (uint32_t i = levelOffsets[level]; i < levelOffsets[level + 1]; ++i)
+                {
+                    if (updated[i])
+                        func(entities[i], worlds[i]);
+                }
+            }
+        }
+
+    private:
+        // Indexed by EntityID
+        std::vector<uint32_t> sparse;
+
+        // Indexed by node, sorted by depth once the order is rebuilt
+        std::vector<Entity> entities;
+        std::vector<Entity> parentEntities;
+        std::vector<uint32_t> parents;
+        std::vector<glm::mat4> locals, worlds;
+        std::vector<uint8_t> localDirty, updated;
+
+        // Nodes of depth d are [levelOffsets[d], levelOffsets[d + 1])
+        std::vector<uint32_t> levelOffsets;
+        bool orderDirty = false;
+
+        // Per level: holds a changed local matrix / was touched by the last update()
+        std::vector<uint8_t> levelDirty, levelUpdated;
+
+        uint32_t find(const Entity& entity) const;
+        uint32_t findOrAdd(const Entity& entity);
+        void markDirty(uint32_t node);
+        void removeNodes(const std::vector<uint8_t>& removed);
+        void rebuildOrder();
+    };
+}
@@ -0,0 +1,197 @@
+#include "triangleJobSystem.hpp"
+
+#include <chrono>
+
+namespace triangle
+{
+    namespace
+    {
+        thread_local const JobSystem* currentJobSystem = nullptr;
+        thread_local uint32_t currentWorkerIndex = 0;
+    }
+
+    JobSystem::JobSystem(uint32_t workerCount)
+    {
+        workerCount = std::max(workerCount, 1u);
+
+        workers.reserve(workerCount);
+        for (uint32_t i = 0; i < workerCount; ++i)
+            workers.push_back(std::make_unique<Worker>());
+
+        threads.reserve(workerCount - 1);
+        for (uint32_t i = 1; i < workerCount; ++i)
+            threads.emplace_back([this, i] { workerLoop(i); });
+    }
+
+    JobSystem::~JobSystem()
+    {
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            stopping = true;
+        }
+        wakeCondition.notify_all();
+
+        for (auto& thread : threads)
+            thread.join();
+    }
+
+    uint32_t JobSystem::getCurrentWorkerIndex() const
+    {
+        if (currentJobSystem == this)
+            return currentWorkerIndex;
+
+        // Compared by id rather than through the thread_local, which another
+        // JobSystem constructed on the same thread would take over
+        return std::this_thread::get_id() == mainThread ? 0 : getWorkerCount();
+    }
+
+    void JobSystem::submit(Job job, Counter& counter)
+    {
+        uint32_t index = getCurrentWorkerIndex();
+        if (index == getWorkerCount())
+            index = nextForeignQueue.fetch_add(1, std::memory_order_relaxed) % getWorkerCount();
+
+        counter.pending.fetch_add(1, std::memory_order_relaxed);
+        {
+            std::lock_guard<std::mutex> lock(workers[index]->mutex);
+            workers[index]->jobs.push_back({std::move(job), &counter});
+        }
+        queuedJobs.fetch_add(1, std::memory_order_release);
+
+        // Taking the sleep mutex orders the increment before a worker's check
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+        }
+        wakeCondition.notify_one();
+    }
+
+    void JobSystem::wait(Counter& counter)
+    {
+        uint32_t index = getCurrentWorkerIndex();
+
+        while (!counter.isDone())
+        {
+            if (!runOne(index))
+            {
+                auto idleStart = std::chrono::steady_clock::now();
+                std::this_thread::yield();
+
+                if (index < getWorkerCount())
+                    addIdleTime(index, idleStart);
+            }
+        }
+    }
+
+    void JobSystem::workerLoop(uint32_t index)
+    {
+        currentJobSystem = this;
+        currentWorkerIndex = index;
+
+        while (!stopping.load(std::memory_order_acquire))
+        {
+            if (runOne(index))
+                continue;
+
+            auto idleStart = std::chrono::steady_clock::now();
+            {
+                std::unique_lock<std::mutex> lock(sleepMutex);
+                wakeCondition.wait(lock, [this] { return stopping || queuedJobs.load(std::memory_order_acquire) > 0; });
+            }
+            addIdleTime(index, idleStart);
+        }
+    }
+
+    bool JobSystem::runOne(uint32_t index)
+    {
+        Entry entry;
+        if (!pop(index, entry) && !steal(index, entry))
+            return false;
+
+        entry.job();
+
+        if (index < getWorkerCount())
+            workers[index]->jobsRun.fetch_add(1, std::memory_order_relaxed);
+
+        entry.counter->pending.fetch_sub(1, std::memory_order_acq_rel);
+
+        return true;
+    }
+
+    bool JobSystem::pop(uint32_t index, Entry& entry)
+    {
+        if (index >= getWorkerCount())
+            return false;
+
+        Worker& worker = *workers[index];
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        if (worker.jobs.empty())
+            return false;
+
+        entry = std::move(worker.jobs.back());
+        worker.jobs.pop_back();
+        queuedJobs.fetch_sub(1, std::memory_order_relaxed);
+
+        return true;
+    }
+
+    bool JobSystem::steal(uint32_t index, Entry& entry)
+    {
+        uint32_t workerCount = getWorkerCount();
+        uint32_t start = index < workerCount ? index + 1 : 0;
+
+        for (uint32_t i = 0; i < workerCount; ++i)
+        {
+            uint32_t victim = (start + i) % workerCount;
+            if (victim == index)
+                continue;
+
+            Worker& worker = *workers[victim];
+            std::lock_guard<std::mutex> lock(worker.mutex);
+            if (worker.jobs.empty())
+                continue;
+
+            entry = std::move(worker.jobs.front());
+            worker.jobs.pop_front();
+            queuedJobs.fetch_sub(1, std::memory_order_relaxed);
+
+            if (index < workerCount)
+                workers[index]->steals.fetch_add(1, std::memory_order_relaxed);
+
+            return true;
+        }
+
+        return false;
+    }
+
+    void JobSystem::addIdleTime(uint32_t index, std::chrono::steady_clock::time_point start)
+    {
+        auto idle = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+        workers[index]->idleNanoseconds.fetch_add(idle.count(), std::memory_order_relaxed);
+    }
+
+    std::vector<JobSystem::WorkerStats> JobSystem::getStats() const
+    {
+        std::vector<WorkerStats> stats;
+        stats.reserve(workers.size());
+
+        for (auto& worker : workers)
+        {
+            stats.push_back(WorkerStats{
+                worker->jobsRun.load(std::memory_order_relaxed),
+                worker->steals.load(std::memory_order_relaxed),
+                worker->idleNanoseconds.load(std::memory_order_relaxed) / 1.0e6});
+        }
+
+        return stats;
+    }
+
+    void JobSystem::resetStats()
+    {
+        for (auto& worker : workers)
+        {
+            worker->jobsRun = 0;
+            worker->steals = 0;
+            worker->idleNanoseconds = 0;
+        }
+    }
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace triangle
+{
+    // Work-stealing job system. Each worker owns a deque: it pushes and pops
+    // its own jobs LIFO, idle workers steal the oldest jobs from the others.
+    // The thread that constructs the JobSystem is worker 0 and only runs jobs
+    // while it waits on a counter.
+    class JobSystem
+    {
+    public:
+        using Job = std::function<void()>;
+
+        // Fork/join counter: incremented per submitted job, decremented once
+        // the job has finished. Must outlive the jobs submitted against it.
+        struct Counter
+        {
+            std::atomic<uint32_t> pending{0};
+
+            bool isDone() const { return pending.load(std::memory_order_acquire) == 0; }
+        };
+
+        struct WorkerStats
+        {
+            uint64_t jobsRun = 0;
+            uint64_t steals = 0;
+            double idleMilliseconds = 0.0;
+        };
+
+        JobSystem(uint32_t workerCount = std::thread::hardware_concurrency());
+        ~JobSystem();
+
+        JobSystem(const JobSystem&) = delete;
+        JobSystem& operator=(const JobSystem&) = delete;
+
+        uint32_t getWorkerCount() const { return static_cast<uint32_t>(workers.size()); }
+
+        // Index of the calling thread in this job system, or getWorkerCount()
+        // for threads that do not belong to it
+        uint32_t getCurrentWorkerIndex() const;
+
+        // Jobs must not throw
+        void submit(Job job, Counter& counter);
+
+        // Runs queued jobs on the calling thread until the counter reaches zero
+        void wait(Counter& counter);
+
+        // Splits [0, count) into ranges of at most grainSize elements and calls
+        // func(begin, end) for each of them, returns once all ranges are done
+        template <typename Func>
+        void parallelFor(uint32_t count, uint32_t grainSize, Func&& func)
+        {
+            if (count == 0)
+                return;
+
+            grainSize = std::max(grainSize, 1u);
+            if (count <= grainSize)
+            {
+                func(0u, count);
+                return;
+            }
+
+            Counter counter;
+            for (uint32_t begin = grainSize; begin < count; begin += grainSize)
+            {
+                uint32_t end = std::min(begin + grainSize, count);
+                submit([&func, begin, end] { func(begin, end); }, counter);
+            }
+
+            func(0u, grainSize);
+            wait(counter);
+        }
+
+        std::vector<WorkerStats> getStats() const;
+        void resetStats();
+
+    private:
+        struct Entry
+        {
+            Job job;
+            Counter* counter;
+        };
+
+        struct Worker
+        {
+            std::mutex mutex;
+            std::deque<Entry> jobs;
+
+            std::atomic<uint64_t> jobsRun{0};
+            std::atomic<uint64_t> steals{0};
+            std::atomic<uint64_t> idleNanoseconds{0};
+        };
+
+        std::vector<std::unique_ptr<Worker>> workers;
+        std::vector<std::thread> threads;
+        // Worker 0, the constructing thread
+        std::thread::id mainThread = std::this_thread::get_id();
+
+        std::atomic<uint32_t> queuedJobs{0};
+        std::atomic<uint32_t> nextForeignQueue{0};
+        std::atomic<bool> stopping{false};
+
+        std::mutex sleepMutex;
+        std::condition_variable wakeCondition;
+
+        void workerLoop(uint32_t index);
+        bool runOne(uint32_t index);
+        bool pop(uint32_t index, Entry& entry);
+        bool steal(uint32_t index, Entry& entry);
+        void addIdleTime(uint32_t index, std::chrono::steady_clock::time_point start);
+    };
+}
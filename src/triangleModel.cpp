@@ -5,6 +5,7 @@
 #include "vulkan/vulkan_handles.hpp"
 #include "vulkan/vulkan_structs.hpp"
 
+#include <algorithm>
 #include <array>
 #include <cstring>
 #include <stdexcept>
@@ -18,18 +19,12 @@ namespace triangle
 
     Model::~Model()
     {
-        device.getLogicalDevice().destroyBuffer(vertexBuffer);
-        device.getLogicalDevice().freeMemory(vertexBufferMemory);
+        destroyMeshBuffer(vertexBuffer);
+        destroyMeshBuffer(indexBuffer);
 
-        device.getLogicalDevice().destroyBuffer(indexBuffer);
-        device.getLogicalDevice().freeMemory(indexBufferMemory);
-
-        for (int i = 0; i < uniformBufferCount; ++i)
-        {
-
-            device.getLogicalDevice().destroyBuffer(uniformBuffers[i]);
-            device.getLogicalDevice().freeMemory(uniformBufferMemories[i]);
-        }
+        destroyUniformBuffers();
+        destroyFrameBuffers(objectBuffers);
+        destroyFrameBuffers(instanceBuffers);
     }
 
     std::vector<vk::VertexInputBindingDescription> Vertex::getBindingDesciptions()
@@ -75,98 +70,217 @@ namespace triangle
         attributeDescription.setOffset(offsetof(Vertex, uv));
         attributeDescriptions.push_back(attributeDescription);
 
-
         return attributeDescriptions;
     }
 
-    void Model::allocVertexBuffer(const std::vector<std::vector<Vertex>>& a_Vertex)
+    // The sphere is centered on the bounding box, not minimal but cheap and stable
+    static void computeBounds(const std::vector<Vertex>& vertices, MeshRange& range)
     {
-        vk::DeviceSize bufferSize = 0, offset = 0;
+        if (vertices.empty())
+            return;
 
-        for (int i = 0; i < a_Vertex.size(); ++i)
+        glm::vec3 minimum = vertices[0].pos, maximum = vertices[0].pos;
+        for (const auto& vertex : vertices)
         {
-            bufferSize += sizeof(a_Vertex[0][0]) * a_Vertex[i].size();
+            minimum = glm::min(minimum, vertex.pos);
+            maximum = glm::max(maximum, vertex.pos);
         }
 
-        vk::Buffer stagingBuffer;
-        vk::DeviceMemory stagingBufferMemory;
+        glm::vec3 center = (minimum + maximum) * 0.5f;
 
-        vk::MemoryPropertyFlags stagingBufferProperties(vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
-        device.createBuffer(bufferSize, vk::BufferUsageFlagBits::eTransferSrc, stagingBufferProperties, stagingBuffer, stagingBufferMemory);
+        float radius = 0.f;
+        for (const auto& vertex : vertices)
+            radius = std::max(radius, glm::length(vertex.pos - center));
 
-        for (int i = 0; i < a_Vertex.size(); ++i)
-        {
-            int verticesByteSize = sizeof(a_Vertex[0][0]) * a_Vertex[i].size();
+        range.aabbMin = minimum;
+        range.aabbMax = maximum;
+        range.boundingSphere = glm::vec4(center, radius);
+    }
 
-            data = device.getLogicalDevice().mapMemory(stagingBufferMemory, offset, verticesByteSize);
-            memcpy(data, a_Vertex[i].data(), verticesByteSize);
-            device.getLogicalDevice().unmapMemory(stagingBufferMemory);
+    bool Model::appendMeshes(const std::vector<const Mesh*>& a_Meshes)
+    {
+        std::vector<Vertex> vertices;
+        std::vector<Index> indices;
 
-            offset += verticesByteSize;
+        for (const Mesh* mesh : a_Meshes)
+        {
+            MeshRange range;
+            range.vertexOffset = static_cast<int32_t>(vertexBuffer.size / sizeof(Vertex) + vertices.size());
+            range.firstIndex = static_cast<uint32_t>(indexBuffer.size / sizeof(Index) + indices.size());
+            range.indexCount = static_cast<uint32_t>(mesh->indices.size());
+            computeBounds(mesh->vertices, range);
+            meshRanges.push_back(range);
+
+            vertices.insert(vertices.end(), mesh->vertices.begin(), mesh->vertices.end());
+            indices.insert(indices.end(), mesh->indices.begin(), mesh->indices.end());
         }
 
-        device.createBuffer(bufferSize, vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eVertexBuffer, vk::MemoryPropertyFlagBits::eDeviceLocal, vertexBuffer, vertexBufferMemory);
+        bool recreated = appendMeshBuffer(vertexBuffer, vertices.data(), sizeof(Vertex) * vertices.size(), vk::BufferUsageFlagBits::eVertexBuffer);
+        recreated |= appendMeshBuffer(indexBuffer, indices.data(), sizeof(Index) * indices.size(), vk::BufferUsageFlagBits::eIndexBuffer);
 
-        device.copyBuffer(stagingBuffer, vertexBuffer, bufferSize);
-
-        device.getLogicalDevice().destroyBuffer(stagingBuffer);
-        device.getLogicalDevice().freeMemory(stagingBufferMemory);
+        return recreated;
     }
 
-    void Model::allocIndexBuffer(const std::vector<std::vector<Index>> &a_Index)
+    bool Model::appendMeshBuffer(MeshBuffer& meshBuffer, const void* a_Data, vk::DeviceSize a_Size, vk::BufferUsageFlags usage)
     {
-        vk::DeviceSize bufferSize = 0, offset = 0;
+        if (a_Size == 0)
+            return false;
 
-        for (int i = 0; i < a_Index.size(); ++i)
+        bool recreated = false;
+        if (meshBuffer.size + a_Size > meshBuffer.capacity)
         {
-            bufferSize += sizeof(Index) * a_Index[i].size();
+            vk::DeviceSize capacity = std::max(meshBuffer.size + a_Size, meshBuffer.capacity * 2);
+
+            vk::Buffer buffer;
+            vk::DeviceMemory memory;
+            device.createBuffer(capacity, vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst | usage,
+                                vk::MemoryPropertyFlagBits::eDeviceLocal, buffer, memory);
+
+            if (meshBuffer.buffer)
+            {
+                // Frames in flight may still read the old buffer
+                device.getLogicalDevice().waitIdle();
+                device.copyBuffer(meshBuffer.buffer, buffer, meshBuffer.size);
+                destroyMeshBuffer(meshBuffer);
+            }
+
+            meshBuffer.buffer = buffer;
+            meshBuffer.memory = memory;
+            meshBuffer.capacity = capacity;
+            recreated = true;
         }
 
         vk::Buffer stagingBuffer;
         vk::DeviceMemory stagingBufferMemory;
-        device.createBuffer(bufferSize, vk::BufferUsageFlagBits::eTransferSrc, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, stagingBuffer, stagingBufferMemory);
-
-        for (int i = 0; i < a_Index.size(); ++i)
-        {
-            int indicesByteSize = sizeof(Index) * a_Index[i].size();
 
-            data = device.getLogicalDevice().mapMemory(stagingBufferMemory, offset, indicesByteSize);
-            memcpy(data, a_Index[i].data(), indicesByteSize);
-            device.getLogicalDevice().unmapMemory(stagingBufferMemory);
+        vk::MemoryPropertyFlags stagingBufferProperties(vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+        device.createBuffer(a_Size, vk::BufferUsageFlagBits::eTransferSrc, stagingBufferProperties, stagingBuffer, stagingBufferMemory);
 
-            offset += indicesByteSize;
-        }
+        data = device.getLogicalDevice().mapMemory(stagingBufferMemory, 0, a_Size);
+        memcpy(data, a_Data, a_Size);
+        device.getLogicalDevice().unmapMemory(stagingBufferMemory);
 
-        device.createBuffer(bufferSize, vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eIndexBuffer, vk::MemoryPropertyFlagBits::eDeviceLocal, indexBuffer, indexBufferMemory);
-        device.copyBuffer(stagingBuffer, indexBuffer, bufferSize);
+        // Lands after the existing meshes, which in-flight frames may be drawing
+        device.copyBuffer(stagingBuffer, meshBuffer.buffer, a_Size, meshBuffer.size);
+        meshBuffer.size += a_Size;
 
         device.getLogicalDevice().destroyBuffer(stagingBuffer);
         device.getLogicalDevice().freeMemory(stagingBufferMemory);
+
+        return recreated;
     }
 
-    void Model::createUniformBuffers(const uint32_t bufferCount, const uint32_t entitySize)
+    void Model::destroyMeshBuffer(MeshBuffer& meshBuffer)
     {
-        uniformBufferCount = bufferCount;
+        device.getLogicalDevice().destroyBuffer(meshBuffer.buffer);
+        device.getLogicalDevice().freeMemory(meshBuffer.memory);
 
-        vk::DeviceSize minUboAlignment = device.getPhysicalDevice().getProperties().limits.minUniformBufferOffsetAlignment;
-        dynamicAlignment = sizeof(MVP);
-
-        if (minUboAlignment > 0)
-            dynamicAlignment = (dynamicAlignment + minUboAlignment - 1) &  ~(minUboAlignment - 1);
+        meshBuffer = MeshBuffer{};
+    }
 
-        vk::DeviceSize bufferSize = dynamicAlignment * entitySize;
+    void Model::createUniformBuffers(const uint32_t bufferCount)
+    {
+        uniformBufferCount = bufferCount;
 
         uniformBuffers.resize(bufferCount);
         uniformBufferMemories.resize(bufferCount);
+        uniformBufferMappings.resize(bufferCount);
 
         vk::MemoryPropertyFlags memoryProperty(vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
         for (int i = 0; i < bufferCount; ++i)
-            device.createBuffer(bufferSize, vk::BufferUsageFlagBits::eUniformBuffer, memoryProperty, uniformBuffers[i], uniformBufferMemories[i]);
+        {
+            device.createBuffer(sizeof(CameraData), vk::BufferUsageFlagBits::eUniformBuffer, memoryProperty, uniformBuffers[i], uniformBufferMemories[i]);
+
+            // Host coherent, writes through the mapping need no flush
+            uniformBufferMappings[i] = device.getLogicalDevice().mapMemory(uniformBufferMemories[i], 0, VK_WHOLE_SIZE);
+        }
+    }
+
+    void Model::createObjectBuffers(const uint32_t bufferCount, const uint32_t objectCapacity)
+    {
+        createFrameBuffers(objectBuffers, bufferCount, objectCapacity, sizeof(ObjectData));
+    }
+
+    void Model::createInstanceBuffers(const uint32_t bufferCount, const uint32_t instanceCapacity)
+    {
+        // Written by the CPU or by the GPU culling pass
+        createFrameBuffers(instanceBuffers, bufferCount, instanceCapacity, sizeof(uint32_t));
+    }
+
+    bool Model::reserveObjectBuffers(const uint32_t objectCount)
+    {
+        return reserveFrameBuffers(objectBuffers, objectCount, sizeof(ObjectData));
+    }
+
+    bool Model::reserveInstanceBuffers(const uint32_t instanceCount)
+    {
+        return reserveFrameBuffers(instanceBuffers, instanceCount, sizeof(uint32_t));
+    }
+
+    void Model::createFrameBuffers(FrameBuffers& frameBuffers, const uint32_t bufferCount, const uint32_t capacity, const vk::DeviceSize elementSize)
+    {
+        frameBuffers.capacity = std::max(capacity, 1u);
+
+        vk::DeviceSize bufferSize = elementSize * frameBuffers.capacity;
+
+        frameBuffers.buffers.resize(bufferCount);
+        frameBuffers.memories.resize(bufferCount);
+        frameBuffers.mappings.resize(bufferCount);
+
+        vk::MemoryPropertyFlags memoryProperty(vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+        for (int i = 0; i < bufferCount; ++i)
+        {
+            device.createBuffer(bufferSize, vk::BufferUsageFlagBits::eStorageBuffer, memoryProperty, frameBuffers.buffers[i], frameBuffers.memories[i]);
+            frameBuffers.mappings[i] = device.getLogicalDevice().mapMemory(frameBuffers.memories[i], 0, VK_WHOLE_SIZE);
+        }
+    }
+
+    bool Model::reserveFrameBuffers(FrameBuffers& frameBuffers, const uint32_t count, const vk::DeviceSize elementSize)
+    {
+        if (count <= frameBuffers.capacity)
+            return false;
+
+        device.getLogicalDevice().waitIdle();
+
+        uint32_t bufferCount = static_cast<uint32_t>(frameBuffers.buffers.size());
+        uint32_t capacity = std::max(count, frameBuffers.capacity * 2);
+
+        destroyFrameBuffers(frameBuffers);
+        createFrameBuffers(frameBuffers, bufferCount, capacity, elementSize);
+
+        return true;
+    }
+
+    void Model::destroyUniformBuffers()
+    {
+        for (int i = 0; i < uniformBufferCount; ++i)
+        {
+            device.getLogicalDevice().unmapMemory(uniformBufferMemories[i]);
+            device.getLogicalDevice().destroyBuffer(uniformBuffers[i]);
+            device.getLogicalDevice().freeMemory(uniformBufferMemories[i]);
+        }
+
+        uniformBuffers.clear();
+        uniformBufferMemories.clear();
+        uniformBufferMappings.clear();
+        uniformBufferCount = 0;
     }
 
     void Model::bind(vk::CommandBuffer &commandBuffer, const vk::DeviceSize &vertexOffset, const vk::DeviceSize &indexOffset)
     {
-        commandBuffer.bindVertexBuffers(0, vertexBuffer, vertexOffset);
-        commandBuffer.bindIndexBuffer(indexBuffer, indexOffset, vk::IndexType::eUint32);
+        commandBuffer.bindVertexBuffers(0, vertexBuffer.buffer, vertexOffset);
+        commandBuffer.bindIndexBuffer(indexBuffer.buffer, indexOffset, vk::IndexType::eUint32);
+    }
+
+    void Model::destroyFrameBuffers(FrameBuffers& frameBuffers)
+    {
+        for (int i = 0; i < frameBuffers.buffers.size(); ++i)
+        {
+            device.getLogicalDevice().unmapMemory(frameBuffers.memories[i]);
+            device.getLogicalDevice().destroyBuffer(frameBuffers.buffers[i]);
+            device.getLogicalDevice().freeMemory(frameBuffers.memories[i]);
+        }
+
+        frameBuffers = FrameBuffers{};
     }
-}
+}
\ No newline at end of file
@@ -13,6 +13,20 @@
 
 namespace triangle
 {
+    // Where one mesh passed to appendMeshes lives in
+    // the shared buffers, in the units drawIndexed expects, and its bounds in
+    // model space
+    struct MeshRange
+    {
+        uint32_t firstIndex = 0, indexCount = 0;
+        int32_t vertexOffset = 0;
+
+        glm::vec3 aabbMin = glm::vec3(0.f), aabbMax = glm::vec3(0.f);
+
+        // center, radius
+        glm::vec4 boundingSphere = glm::vec4(0.f);
+    };
+
     class Model
     {
     public:
@@ -21,28 +35,92 @@ namespace triangle
 
         std::vector<vk::Buffer> getUniformBuffers() { return uniformBuffers; };
         vk::DeviceMemory getUniformBufferMemory(int index) { return uniformBufferMemories[index]; };
-        vk::DeviceSize getDynamicAlignment() { return dynamicAlignment; }
+
+        // Uniform buffers stay mapped for their whole lifetime, each holds
+        // the CameraData of one frame in flight
+        void* getUniformBufferMapping(int index) { return uniformBufferMappings[index]; }
+
+        // Object buffers, one per frame in flight, also stay mapped. Entry
+        // id - 1 holds the ObjectData of entity id for as long as it lives,
+        // so only objects that changed need to be written.
+        std::vector<vk::Buffer> getObjectBuffers() { return objectBuffers.buffers; }
+        void* getObjectBufferMapping(int index) { return objectBuffers.mappings[index]; }
+        vk::Buffer getObjectBuffer(int index) { return objectBuffers.buffers[index]; }
+        uint32_t getObjectBufferCapacity() { return objectBuffers.capacity; }
+
+        // Instance buffers, one per frame in flight, mapped as well. Each holds
+        // getInstanceBufferCapacity() object slots, one per drawn instance.
+        std::vector<vk::Buffer> getInstanceBuffers() { return instanceBuffers.buffers; }
+        void* getInstanceBufferMapping(int index) { return instanceBuffers.mappings[index]; }
+        vk::Buffer getInstanceBuffer(int index) { return instanceBuffers.buffers[index]; }
+        uint32_t getInstanceBufferCapacity() { return instanceBuffers.capacity; }
+
+        uint32_t getMeshCount() { return static_cast<uint32_t>(meshRanges.size()); }
+        const MeshRange& getMeshRange(uint32_t mesh) { return meshRanges[mesh]; }
 
         void bind(vk::CommandBuffer &commandBuffer, const vk::DeviceSize &vertexOffset, const vk::DeviceSize &indexOffset);
-        void createUniformBuffers(const uint32_t bufferCount, const uint32_t entitySize);
 
-        void allocVertexBuffer(const std::vector<std::vector<Vertex>>& a_Vertex);
-        void allocIndexBuffer(const std::vector<std::vector<Index>>& a_Index);
+        void createUniformBuffers(const uint32_t bufferCount);
+
+        void createObjectBuffers(const uint32_t bufferCount, const uint32_t objectCapacity);
+        void createInstanceBuffers(const uint32_t bufferCount, const uint32_t instanceCapacity);
+
+        // Grow every object / instance buffer to hold at least count entries,
+        // at least doubling the capacity. Wait for the device to go idle
+        // first. Return true when the buffers were recreated: descriptors
+        // must be updated and the previous contents are lost.
+        bool reserveObjectBuffers(const uint32_t objectCount);
+        bool reserveInstanceBuffers(const uint32_t instanceCount);
+
+        // Uploads the meshes after the ones already in the shared vertex and
+        // index buffers, mesh i landing at getMeshRange(getMeshCount() + i).
+        // Existing ranges never move. The buffers grow by at least doubling,
+        // which waits for the device to go idle. Returns true when they were
+        // recreated: command buffers that bound them are stale.
+        bool appendMeshes(const std::vector<const Mesh*>& a_Meshes);
         
     private:
         Device& device;
 
         uint32_t uniformBufferCount = 0;
-        vk::DeviceSize dynamicAlignment = 0;
 
-        vk::Buffer vertexBuffer = VK_NULL_HANDLE, indexBuffer = VK_NULL_HANDLE;
-        vk::DeviceMemory vertexBufferMemory, indexBufferMemory;
+        // Device local, meshes are appended at size
+        struct MeshBuffer
+        {
+            vk::Buffer buffer = VK_NULL_HANDLE;
+            vk::DeviceMemory memory;
+            vk::DeviceSize size = 0, capacity = 0;
+        };
+
+        MeshBuffer vertexBuffer, indexBuffer;
 
         std::vector<vk::Buffer> uniformBuffers;
         std::vector<vk::DeviceMemory> uniformBufferMemories;
+        std::vector<void*> uniformBufferMappings;
+
+        // Host visible storage buffers, one per frame in flight
+        struct FrameBuffers
+        {
+            std::vector<vk::Buffer> buffers;
+            std::vector<vk::DeviceMemory> memories;
+            std::vector<void*> mappings;
+            uint32_t capacity = 0;
+        };
+
+        FrameBuffers objectBuffers, instanceBuffers;
+
+        std::vector<MeshRange> meshRanges;
 
         void* data;
 
         uint32_t findMemoryType(uint32_t typeFilter, vk::MemoryPropertyFlags properties);
+        void destroyUniformBuffers();
+
+        void createFrameBuffers(FrameBuffers& frameBuffers, const uint32_t bufferCount, const uint32_t capacity, const vk::DeviceSize elementSize);
+        bool reserveFrameBuffers(FrameBuffers& frameBuffers, const uint32_t count, const vk::DeviceSize elementSize);
+        void destroyFrameBuffers(FrameBuffers& frameBuffers);
+
+        bool appendMeshBuffer(MeshBuffer& meshBuffer, const void* a_Data, vk::DeviceSize a_Size, vk::BufferUsageFlags usage);
+        void destroyMeshBuffer(MeshBuffer& meshBuffer);
     };
 }
\ No newline at end of file
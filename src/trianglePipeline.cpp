@@ -23,6 +23,9 @@ namespace triangle
         for (auto &shaderModule : fragShaderModule)
             device.getLogicalDevice().destroyShaderModule(shaderModule);
 
+        for (auto &shaderModule : compShaderModule)
+            device.getLogicalDevice().destroyShaderModule(shaderModule);
+
     }
 
     std::vector<char> Pipeline::readFile(const char* filename)
@@ -303,6 +306,27 @@ namespace triangle
         return pipeline;
     }
 
+    vk::Pipeline Pipeline::createComputePipeline(const vk::PipelineLayout &layout, const char *compFilePath)
+    {
+        auto compShaderCode = Pipeline::readFile(compFilePath);
+
+        compShaderModule.push_back(createShaderModule(compShaderCode));
+
+        vk::PipelineShaderStageCreateInfo pipelineShaderStageCreateInfo(
+            vk::PipelineShaderStageCreateFlags(), vk::ShaderStageFlagBits::eCompute, compShaderModule.back(), "main", nullptr);
+
+        vk::ComputePipelineCreateInfo pipelineCreateInfo(
+            vk::PipelineCreateFlags(),
+            pipelineShaderStageCreateInfo,
+            layout);
+
+        vk::Result result;
+        vk::Pipeline computePipeline;
+        std::tie(result, computePipeline) = device.getLogicalDevice().createComputePipeline(nullptr, pipelineCreateInfo);
+
+        return computePipeline;
+    }
+
     vk::ShaderModule Pipeline::createShaderModule(const std::vector<char>& code)
     {
         vk::ShaderModuleCreateInfo shaderModuleCreateInfo(vk::ShaderModuleCreateFlags(), code.size(), reinterpret_cast<const uint32_t*>(code.data()));
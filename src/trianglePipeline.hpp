@@ -34,6 +34,7 @@ namespace triangle
         vk::Pipeline createGraphicsPipeline(PipelineConfig &pipelineConfig, const char *vertFilePath, const char *fragFilePath);
         vk::Pipeline createDefaultGraphicsPipeline(vk::PipelineLayout& layout, const vk::RenderPass& renderPass);
         vk::Pipeline createTextureGraphicsPipeline(vk::PipelineLayout &layout, const vk::RenderPass &renderPass);
+        vk::Pipeline createComputePipeline(const vk::PipelineLayout &layout, const char *compFilePath);
         ~Pipeline();
 
         void bind(vk::CommandBuffer &commandBuffer);
@@ -43,7 +44,7 @@ namespace triangle
 
         static std::vector<char> readFile(const char* filename);
 
-        std::vector<vk::ShaderModule> vertShaderModule, fragShaderModule;
+        std::vector<vk::ShaderModule> vertShaderModule, fragShaderModule, compShaderModule;
 
         vk::ShaderModule createShaderModule(const std::vector<char>& code);
         vk::Pipeline pipeline;
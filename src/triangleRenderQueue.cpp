@@ -0,0 +1,60 @@
+#include "triangleRenderQueue.hpp"
+
+#include <algorithm>
+#include <array>
+
+namespace triangle
+{
+    uint64_t RenderKey::make(uint32_t pass, uint32_t pipeline, uint32_t descriptorSet, uint32_t mesh, float depth)
+    {
+        auto mask = [](uint32_t value, uint32_t bits) { return uint64_t(value) & ((uint64_t(1) << bits) - 1); };
+
+        // NaN compares false and ends up at 0
+        float clamped = depth > 0.f ? std::min(depth, 1.f) : 0.f;
+        uint32_t quantized = static_cast<uint32_t>(clamped * float((1u << depthBits) - 1));
+
+        return (mask(pass, passBits) << passShift) |
+               (mask(pipeline, pipelineBits) << pipelineShift) |
+               (mask(descriptorSet, descriptorSetBits) << descriptorSetShift) |
+               (mask(mesh, meshBits) << meshShift) |
+               mask(quantized, depthBits);
+    }
+
+    void RenderQueue::sort()
+    {
+        if (items.size() < 2)
+            return;
+
+        scratch.resize(items.size());
+
+        // One histogram per key byte, built in a single pass
+        std::array<std::array<uint32_t, 256>, 8> counts{};
+        for (const Item& item : items)
+        {
+            for (uint32_t byte = 0; byte < 8; ++byte)
+                ++counts[byte][(item.key >> (byte * 8)) & 0xFF];
+        }
+
+        for (uint32_t byte = 0; byte < 8; ++byte)
+        {
+            auto& count = counts[byte];
+
+            // Every key has the same value in this byte, the pass would not move anything
+            if (count[(items[0].key >> (byte * 8)) & 0xFF] == items.size())
+                continue;
+
+            uint32_t offset = 0;
+            for (auto& bucket : count)
+            {
+                uint32_t size = bucket;
+                bucket = offset;
+                offset += size;
+            }
+
+            for (const Item& item : items)
+                scratch[count[(item.key >> (byte * 8)) & 0xFF]++] = item;
+
+            items.swap(scratch);
+        }
+    }
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace triangle
+{
+    // Packs the state a draw needs into one integer so that sorting by it
+    // groups draws by pass, then pipeline, then descriptor set, then mesh,
+    // and orders each batch by depth. Bits, most significant first:
+    //   pass 4 | pipeline 12 | descriptor set 12 | mesh 16 | depth 20
+    struct RenderKey
+    {
+        static constexpr uint32_t depthBits = 20, meshBits = 16, descriptorSetBits = 12, pipelineBits = 12, passBits = 4;
+        static constexpr uint32_t meshShift = depthBits;
+        static constexpr uint32_t descriptorSetShift = meshShift + meshBits;
+        static constexpr uint32_t pipelineShift = descriptorSetShift + descriptorSetBits;
+        static constexpr uint32_t passShift = pipelineShift + pipelineBits;
+
+        // Depth is a view space distance in [0, 1] after dividing by the far
+        // plane, values outside are clamped
+        static uint64_t make(uint32_t pass, uint32_t pipeline, uint32_t descriptorSet, uint32_t mesh, float depth);
+
+        // Draws with the same batch can be merged into one instanced call
+        static uint64_t batch(uint64_t key) { return key >> depthBits; }
+
+        static uint32_t pipeline(uint64_t key) { return field(key, pipelineShift, pipelineBits); }
+        static uint32_t descriptorSet(uint64_t key) { return field(key, descriptorSetShift, descriptorSetBits); }
+        static uint32_t mesh(uint64_t key) { return field(key, meshShift, meshBits); }
+
+    private:
+        static uint32_t field(uint64_t key, uint32_t shift, uint32_t bits)
+        {
+            return static_cast<uint32_t>((key >> shift) & ((uint64_t(1) << bits) - 1));
+        }
+    };
+
+    // Per frame list of (key, draw index) pairs, sorted with an LSD radix sort
+    // over the key bytes. Bytes that are equal for every key, usually the
+    // pass and the unused high bits, are skipped.
+    class RenderQueue
+    {
+    public:
+        struct Item
+        {
+            uint64_t key;
+            uint32_t index;
+        };
+
+        void clear() { items.clear(); }
+        void reserve(size_t count) { items.reserve(count); }
+        void push(uint64_t key, uint32_t index) { items.push_back(Item{key, index}); }
+
+        size_t size() const { return items.size(); }
+        const Item& operator[](size_t i) const { return items[i]; }
+
+        // Stable, so draws with equal keys keep the order they were pushed in
+        void sort();
+
+    private:
+        std::vector<Item> items, scratch;
+    };
+}
@@ -30,6 +30,7 @@ namespace triangle
         ImGui_ImplGlfw_Shutdown();
         ImGui::DestroyContext();
 
+        destroySecondaryCommandPools();
         destroyCommandBuffer();     
     }
 
@@ -94,25 +95,148 @@ namespace triangle
 
     void Renderer::createCommandBuffer()
     {
+        vk::CommandPoolCreateInfo commandPoolCreateInfo(vk::CommandPoolCreateFlagBits::eTransient, device.getQueueFamilyIndex().graphics);
 
-        vk::CommandBufferAllocateInfo cmdBufferAllocateInfo(
-            device.getCommandPool(),
-            vk::CommandBufferLevel::ePrimary,
-            commandBuffers.size());
+        frameCommandPools.resize(commandBuffers.size());
+        for (uint32_t i = 0; i < commandBuffers.size(); ++i)
+        {
+            frameCommandPools[i] = device.getLogicalDevice().createCommandPool(commandPoolCreateInfo);
+
+            vk::CommandBufferAllocateInfo cmdBufferAllocateInfo(
+                frameCommandPools[i],
+                vk::CommandBufferLevel::ePrimary,
+                1);
 
-        commandBuffers = device.getLogicalDevice().allocateCommandBuffers(cmdBufferAllocateInfo);
+            commandBuffers[i] = device.getLogicalDevice().allocateCommandBuffers(cmdBufferAllocateInfo).front();
+        }
     }
 
     void Renderer::createUICommandBuffer()
     {
         uiCommandBuffers.resize(swapchain->MAX_FRAMES_IN_FLIGHT);
 
-        vk::CommandBufferAllocateInfo allocInfo(
-            device.getCommandPool(),
-            vk::CommandBufferLevel::ePrimary,
-            uiCommandBuffers.size());
+        for (uint32_t i = 0; i < uiCommandBuffers.size(); ++i)
+        {
+            vk::CommandBufferAllocateInfo allocInfo(
+                frameCommandPools[i],
+                vk::CommandBufferLevel::ePrimary,
+                1);
+
+            uiCommandBuffers[i] = device.getLogicalDevice().allocateCommandBuffers(allocInfo).front();
+        }
+    }
+
+    void Renderer::resetFrameCommandPools()
+    {
+        // Every command buffer of the frame returns to the initial state at
+        // once, cheaper than resetting them one by one
+        device.getLogicalDevice().resetCommandPool(frameCommandPools[currentFrame]);
+
+        if (secondaryCommandPools.empty())
+            return;
+
+        for (auto& threadPool : secondaryCommandPools[currentFrame])
+        {
+            device.getLogicalDevice().resetCommandPool(threadPool.pool);
+            threadPool.used = 0;
+        }
+    }
+
+    void Renderer::createSecondaryCommandPools(uint32_t threadCount)
+    {
+        destroySecondaryCommandPools();
+
+        vk::CommandPoolCreateInfo commandPoolCreateInfo(vk::CommandPoolCreateFlagBits::eTransient, device.getQueueFamilyIndex().graphics);
+
+        secondaryCommandPools.resize(swapchain->MAX_FRAMES_IN_FLIGHT);
+        for (auto& framePools : secondaryCommandPools)
+        {
+            framePools.resize(threadCount);
+            for (auto& threadPool : framePools)
+                threadPool.pool = device.getLogicalDevice().createCommandPool(commandPoolCreateInfo);
+        }
+
+        vk::CommandPoolCreateInfo cachedPoolCreateInfo(vk::CommandPoolCreateFlagBits::eResetCommandBuffer, device.getQueueFamilyIndex().graphics);
+
+        cachedCommandPools.resize(swapchain->MAX_FRAMES_IN_FLIGHT);
+        for (auto& framePools : cachedCommandPools)
+        {
+            framePools.resize(threadCount);
+            for (auto& slotPool : framePools)
+            {
+                slotPool.pool = device.getLogicalDevice().createCommandPool(cachedPoolCreateInfo);
+
+                vk::CommandBufferAllocateInfo allocInfo(slotPool.pool, vk::CommandBufferLevel::eSecondary, 1);
+                slotPool.commandBuffer = device.getLogicalDevice().allocateCommandBuffers(allocInfo).front();
+            }
+        }
+    }
+
+    void Renderer::destroySecondaryCommandPools()
+    {
+        // Destroying a pool frees its command buffers
+        for (auto& framePools : secondaryCommandPools)
+        {
+            for (auto& threadPool : framePools)
+                device.getLogicalDevice().destroyCommandPool(threadPool.pool);
+        }
+
+        secondaryCommandPools.clear();
 
-        uiCommandBuffers = device.getLogicalDevice().allocateCommandBuffers(allocInfo);
+        for (auto& framePools : cachedCommandPools)
+        {
+            for (auto& slotPool : framePools)
+                device.getLogicalDevice().destroyCommandPool(slotPool.pool);
+        }
+
+        cachedCommandPools.clear();
+    }
+
+    vk::CommandBuffer Renderer::beginSecondaryCommandBuffer(uint32_t threadIndex)
+    {
+        SecondaryCommandPool& threadPool = secondaryCommandPools[currentFrame][threadIndex];
+
+        if (threadPool.used == threadPool.commandBuffers.size())
+        {
+            vk::CommandBufferAllocateInfo allocInfo(threadPool.pool, vk::CommandBufferLevel::eSecondary, 1);
+            threadPool.commandBuffers.push_back(device.getLogicalDevice().allocateCommandBuffers(allocInfo)[0]);
+        }
+
+        vk::CommandBuffer commandBuffer = threadPool.commandBuffers[threadPool.used++];
+        beginInMainRenderPass(commandBuffer, vk::CommandBufferUsageFlagBits::eOneTimeSubmit, swapchain->getMainFramebuffers()[imageIndex]);
+
+        return commandBuffer;
+    }
+
+    vk::CommandBuffer Renderer::beginCachedCommandBuffer(uint32_t slot)
+    {
+        // The frame's fence has signaled, the previous recording is no longer pending
+        vk::CommandBuffer commandBuffer = cachedCommandPools[currentFrame][slot].commandBuffer;
+        commandBuffer.reset();
+
+        beginInMainRenderPass(commandBuffer, vk::CommandBufferUsageFlags(), VK_NULL_HANDLE);
+
+        return commandBuffer;
+    }
+
+    void Renderer::beginInMainRenderPass(vk::CommandBuffer& commandBuffer, vk::CommandBufferUsageFlags usage, vk::Framebuffer framebuffer)
+    {
+        vk::CommandBufferInheritanceInfo inheritanceInfo(swapchain->getMainRenderPass(), 0, framebuffer);
+
+        commandBuffer.begin(vk::CommandBufferBeginInfo(usage | vk::CommandBufferUsageFlagBits::eRenderPassContinue, &inheritanceInfo));
+
+        // Dynamic state is not inherited from the primary command buffer
+        vk::Viewport viewport(0.0f, 0.0f, static_cast<float>(swapchain->getExtent().width), static_cast<float>(swapchain->getExtent().height), 0.0f, 1.0f);
+        commandBuffer.setViewport(0, viewport);
+
+        vk::Rect2D scissor({0, 0}, swapchain->getExtent());
+        commandBuffer.setScissor(0, scissor);
+    }
+
+    void Renderer::executeSecondaryCommandBuffers(const std::vector<vk::CommandBuffer>& secondaryCommandBuffers)
+    {
+        if (!secondaryCommandBuffers.empty())
+            commandBuffers[currentFrame].executeCommands(secondaryCommandBuffers);
     }
 
     void Renderer::createUI(std::function<void()> frameCallback)
@@ -133,10 +257,12 @@ namespace triangle
             return nullptr;
         }
 
+        // acquireNextImage waited on the frame's fence, none of its command buffers are pending
+        resetFrameCommandPools();
+
         renderUI();
 
-        commandBuffers[currentFrame].reset();
-        vk::CommandBufferBeginInfo commandBufferBeginInfo(vk::CommandBufferUsageFlags(), nullptr);
+        vk::CommandBufferBeginInfo commandBufferBeginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit, nullptr);
 
         commandBuffers[currentFrame].begin(commandBufferBeginInfo);
 
@@ -148,7 +274,7 @@ namespace triangle
         commandBuffers[currentFrame].end();
     }
 
-    void Renderer::beginRenderPass()
+    void Renderer::beginRenderPass(vk::SubpassContents contents)
     {
         std::array<vk::ClearValue, 2> clearValues;
         clearValues[0].setColor(vk::ClearColorValue(std::array<float, 4>({{0.0f, 0.0f, 0.0f, 1.0f}})));
@@ -160,7 +286,11 @@ namespace triangle
             {{0, 0}, swapchain->getExtent()},
             clearValues);
         
-        commandBuffers[currentFrame].beginRenderPass(renderPassBeginInfo, vk::SubpassContents::eInline);
+        commandBuffers[currentFrame].beginRenderPass(renderPassBeginInfo, contents);
+
+        // Secondary command buffers set their own
+        if (contents == vk::SubpassContents::eSecondaryCommandBuffers)
+            return;
 
         vk::Viewport viewport(0.0f, 0.0f, static_cast<float>(swapchain->getExtent().width), static_cast<float>(swapchain->getExtent().height), 0.0f, 1.0f);
         commandBuffers[currentFrame].setViewport(0, viewport);
@@ -215,18 +345,24 @@ namespace triangle
 
         device.getLogicalDevice().waitIdle();
         swapchain = std::make_unique<Swapchain>(device);
+        ++swapchainGeneration;
     }
 
     void Renderer::destroyCommandBuffer()
     {
-        device.getLogicalDevice().freeCommandBuffers(device.getCommandPool(), commandBuffers);
+        // Destroying the pools frees the primary and UI command buffers
+        for (auto& commandPool : frameCommandPools)
+            device.getLogicalDevice().destroyCommandPool(commandPool);
+
+        frameCommandPools.clear();
+        commandBuffers.clear();
+        uiCommandBuffers.clear();
     }
 
     void Renderer::renderUI()
     {
         ImGui::Render();
-        uiCommandBuffers[currentFrame].reset();
-        // No need to reset command pool because the ui command buffer is using the same command pool
+        // Already reset along with the frame's command pool
         vk::CommandBufferBeginInfo beginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
 
         uiCommandBuffers[currentFrame].begin(beginInfo);
@@ -24,6 +24,10 @@ namespace triangle
         
         vk::CommandBuffer& getCurrentCommandBuffer() { return commandBuffers.at(currentFrame); }
         uint32_t getCurrentFrame() { return currentFrame; }
+
+        // Bumped on every swapchain recreation, command buffers recorded
+        // against the previous render pass or extent are stale
+        uint32_t getSwapchainGeneration() { return swapchainGeneration; }
         int getMaxFramesInFlight() { return swapchain->MAX_FRAMES_IN_FLIGHT; }
         vk::RenderPass getMainRenderPass() { return swapchain->getMainRenderPass(); }
         float getAspectRatio() { return swapchain->getExtent().width / swapchain->getExtent().height; }
@@ -35,14 +39,40 @@ namespace triangle
         vk::CommandBuffer beginCommandBuffer();
         void endCommandBuffer();
 
-        void beginRenderPass();
+        // With eSecondaryCommandBuffers the main pass may only be filled
+        // through executeSecondaryCommandBuffers
+        void beginRenderPass(vk::SubpassContents contents = vk::SubpassContents::eInline);
         void endRenderpass();
 
+        // One command pool per recording thread and frame in flight, since a
+        // pool may only be used by one thread at a time. Thread indices are
+        // in [0, threadCount). Also creates threadCount cached slots per frame.
+        void createSecondaryCommandPools(uint32_t threadCount);
+
+        // Returns a secondary command buffer from the pool of threadIndex for
+        // the current frame, begun inside the main render pass with viewport
+        // and scissor set. Safe to call concurrently with distinct indices.
+        vk::CommandBuffer beginSecondaryCommandBuffer(uint32_t threadIndex);
+
+        // Same, but the command buffer of the current frame's cached slot is
+        // not reset with the frame and may be executed again in later frames
+        // using the same frame index, until the slot is begun again. It does
+        // not inherit a framebuffer since the swapchain image varies. Safe
+        // to call concurrently with distinct slots.
+        vk::CommandBuffer beginCachedCommandBuffer(uint32_t slot);
+
+        // Executes ended secondary command buffers, in order, from the
+        // current primary command buffer
+        void executeSecondaryCommandBuffers(const std::vector<vk::CommandBuffer>& secondaryCommandBuffers);
+
         void submitBuffer();
         void destroyCommandBuffer();
     private:
         void createCommandBuffer();
         void createUICommandBuffer();
+        void resetFrameCommandPools();
+        void destroySecondaryCommandPools();
+        void beginInMainRenderPass(vk::CommandBuffer& commandBuffer, vk::CommandBufferUsageFlags usage, vk::Framebuffer framebuffer);
         void recreateSwapchain();
 
         void setupDebugUI();
@@ -52,9 +82,35 @@ namespace triangle
         std::unique_ptr<Swapchain> swapchain;
         Window& window;
 
+        // One transient pool per frame in flight holds that frame's primary
+        // and UI command buffers, reset as a whole once its fence signaled
+        std::vector<vk::CommandPool> frameCommandPools;
         std::vector<vk::CommandBuffer> commandBuffers, uiCommandBuffers;
         vk::DescriptorPool imguiDescPool;
 
+        // Command buffers are allocated on first use and kept, the pool is
+        // reset with the frame. used counts how many were handed out this frame.
+        struct SecondaryCommandPool
+        {
+            vk::CommandPool pool;
+            std::vector<vk::CommandBuffer> commandBuffers;
+            uint32_t used = 0;
+        };
+
+        // [frame][thread]
+        std::vector<std::vector<SecondaryCommandPool>> secondaryCommandPools;
+
+        // [frame][slot], one command buffer each, reset individually when
+        // the slot is recorded again
+        struct CachedCommandPool
+        {
+            vk::CommandPool pool;
+            vk::CommandBuffer commandBuffer;
+        };
+
+        std::vector<std::vector<CachedCommandPool>> cachedCommandPools;
+        uint32_t swapchainGeneration = 0;
+
         uint32_t currentFrame = 0, imageIndex;
     };
 }
\ No newline at end of file
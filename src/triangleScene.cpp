@@ -0,0 +1,251 @@
+#include "triangleScene.hpp"
+
+#include <cstring>
+#include <fstream>
+
+#ifdef _WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #define NOMINMAX
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+namespace triangle
+{
+    namespace
+    {
+        uint64_t alignOffset(uint64_t offset)
+        {
+            return (offset + sceneBlockAlignment - 1) & ~(sceneBlockAlignment - 1);
+        }
+    }
+
+#ifdef _WIN32
+    MappedFile::MappedFile(const std::string& a_Path)
+    {
+        m_File = CreateFileA(a_Path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (m_File == INVALID_HANDLE_VALUE)
+        {
+            m_File = nullptr;
+            throw std::runtime_error("Failed to open scene file");
+        }
+
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(m_File, &size))
+        {
+            CloseHandle(m_File);
+            throw std::runtime_error("Failed to read scene file size");
+        }
+        m_Size = static_cast<size_t>(size.QuadPart);
+
+        if (m_Size == 0)
+            return;
+
+        m_Mapping = CreateFileMappingA(m_File, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (m_Mapping)
+            m_Data = static_cast<const std::byte*>(MapViewOfFile(m_Mapping, FILE_MAP_READ, 0, 0, 0));
+
+        if (!m_Data)
+        {
+            if (m_Mapping)
+                CloseHandle(m_Mapping);
+            CloseHandle(m_File);
+            throw std::runtime_error("Failed to map scene file");
+        }
+    }
+
+    MappedFile::~MappedFile()
+    {
+        if (m_Data)
+            UnmapViewOfFile(m_Data);
+        if (m_Mapping)
+            CloseHandle(m_Mapping);
+        if (m_File)
+            CloseHandle(m_File);
+    }
+#else
+    MappedFile::MappedFile(const std::string& a_Path)
+    {
+        m_Descriptor = open(a_Path.c_str(), O_RDONLY);
+        if (m_Descriptor < 0)
+            throw std::runtime_error("Failed to open scene file");
+
+        struct stat status;
+        if (fstat(m_Descriptor, &status) != 0)
+        {
+            close(m_Descriptor);
+            throw std::runtime_error("Failed to read scene file size");
+        }
+        m_Size = static_cast<size_t>(status.st_size);
+
+        if (m_Size == 0)
+            return;
+
+        void* data = mmap(nullptr, m_Size, PROT_READ, MAP_PRIVATE, m_Descriptor, 0);
+        if (data == MAP_FAILED)
+        {
+            close(m_Descriptor);
+            throw std::runtime_error("Failed to map scene file");
+        }
+
+        // Every block is copied out right away, start reading ahead now
+        madvise(data, m_Size, MADV_WILLNEED);
+        m_Data = static_cast<const std::byte*>(data);
+    }
+
+    MappedFile::~MappedFile()
+    {
+        if (m_Data)
+            munmap(const_cast<std::byte*>(m_Data), m_Size);
+        if (m_Descriptor >= 0)
+            close(m_Descriptor);
+    }
+#endif
+
+    void SceneSerializer::write(const std::string& a_Path, uint32_t a_Tick, uint32_t a_ComponentCount, std::vector<BlockSource>& a_Blocks)
+    {
+        SceneHeader header{};
+        std::memcpy(header.magic, sceneMagic, sizeof(sceneMagic));
+        header.version = sceneVersion;
+        header.blockCount = static_cast<uint32_t>(a_Blocks.size());
+        header.tick = a_Tick;
+        header.componentCount = a_ComponentCount;
+
+        uint64_t offset = alignOffset(sizeof(SceneHeader) + a_Blocks.size() * sizeof(SceneBlock));
+        for (auto& source : a_Blocks)
+        {
+            source.block.offset = offset;
+            offset = alignOffset(offset + source.block.count * source.block.elementSize);
+        }
+
+        std::ofstream file(a_Path, std::ios::binary | std::ios::trunc);
+        if (!file)
+            throw std::runtime_error("Failed to create scene file");
+
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        for (const auto& source : a_Blocks)
+            file.write(reinterpret_cast<const char*>(&source.block), sizeof(SceneBlock));
+
+        const char padding[sceneBlockAlignment] = {};
+        for (const auto& source : a_Blocks)
+        {
+            uint64_t position = static_cast<uint64_t>(file.tellp());
+            file.write(padding, static_cast<std::streamsize>(source.block.offset - position));
+            file.write(static_cast<const char*>(source.data), static_cast<std::streamsize>(source.block.count * source.block.elementSize));
+        }
+
+        if (!file)
+            throw std::runtime_error("Failed to write scene file");
+    }
+
+    std::vector<SceneBlock> SceneSerializer::readTable(const MappedFile& a_File, SceneHeader& a_Header)
+    {
+        if (a_File.size() < sizeof(SceneHeader))
+            throw std::runtime_error("Scene file is truncated");
+
+        std::memcpy(&a_Header, a_File.data(), sizeof(SceneHeader));
+        if (std::memcmp(a_Header.magic, sceneMagic, sizeof(sceneMagic)) != 0)
+            throw std::runtime_error("Not a scene file");
+        if (a_Header.version != sceneVersion)
+            throw std::runtime_error("Unsupported scene version");
+
+        uint64_t tableEnd = sizeof(SceneHeader) + uint64_t(a_Header.blockCount) * sizeof(SceneBlock);
+        if (tableEnd > a_File.size())
+            throw std::runtime_error("Scene file is truncated");
+
+        std::vector<SceneBlock> blocks(a_Header.blockCount);
+        if (!blocks.empty())
+            std::memcpy(blocks.data(), a_File.data() + sizeof(SceneHeader), blocks.size() * sizeof(SceneBlock));
+
+        for (const auto& block : blocks)
+        {
+            if (block.offset % sceneBlockAlignment != 0 || block.offset < tableEnd || block.offset > a_File.size() ||
+                block.elementSize == 0 || block.count > (a_File.size() - block.offset) / block.elementSize)
+                throw std::runtime_error("Scene block lies outside the file");
+        }
+
+        return blocks;
+    }
+
+    void SceneSerializer::validateEntities(const EntityAllocator& a_Allocator, const std::vector<Signature>& a_Signatures)
+    {
+        const auto& generations = a_Allocator.m_Generations;
+        const auto& entityIndices = a_Allocator.m_EntityIndices;
+        const auto& entities = a_Allocator.m_Entities;
+
+        if (generations.empty() || entityIndices.size() != generations.size() || a_Signatures.size() > generations.size() ||
+            entityIndices[0] != npos)
+            throw std::runtime_error("Scene entity blocks are inconsistent");
+
+        for (uint32_t i = 0; i < entities.size(); ++i)
+        {
+            const Entity& entity = entities[i];
+            if (entity.id == 0 || entity.id >= generations.size() || generations[entity.id] != entity.generation ||
+                entityIndices[entity.id] != i)
+                throw std::runtime_error("Scene entity blocks are inconsistent");
+        }
+
+        // Together with the loop above, live slots and m_Entities are a bijection
+        uint32_t liveCount = 0;
+        for (uint32_t index : entityIndices)
+        {
+            if (index == npos)
+                continue;
+            if (index >= entities.size())
+                throw std::runtime_error("Scene entity blocks are inconsistent");
+            ++liveCount;
+        }
+        if (liveCount != entities.size())
+            throw std::runtime_error("Scene entity blocks are inconsistent");
+
+        // Each dead id once, so create() never hands out a live or duplicate id
+        const auto& freeList = a_Allocator.m_FreeList;
+        if (freeList.size() != generations.size() - 1 - entities.size())
+            throw std::runtime_error("Scene free list is inconsistent");
+
+        std::vector<uint8_t> freed(generations.size(), 0);
+        for (EntityID id : freeList)
+        {
+            if (id == 0 || id >= generations.size() || entityIndices[id] != npos || freed[id])
+                throw std::runtime_error("Scene free list is inconsistent");
+            freed[id] = 1;
+        }
+    }
+
+    void SceneSerializer::validatePool(std::span<const uint32_t> a_Sparse, std::span<const EntityID> a_Entities,
+        const EntityAllocator& a_Allocator, const std::vector<Signature>& a_Signatures, ComponentID a_Component)
+    {
+        if (a_Sparse.size() > a_Allocator.m_Generations.size())
+            throw std::runtime_error("Scene pool blocks are inconsistent");
+
+        uint32_t mappedCount = 0;
+        for (uint32_t index : a_Sparse)
+        {
+            if (index == npos)
+                continue;
+            if (index >= a_Entities.size())
+                throw std::runtime_error("Scene pool blocks are inconsistent");
+            ++mappedCount;
+        }
+        if (mappedCount != a_Entities.size())
+            throw std::runtime_error("Scene pool blocks are inconsistent");
+
+        for (uint32_t i = 0; i < a_Entities.size(); ++i)
+        {
+            EntityID id = a_Entities[i];
+            if (id >= a_Sparse.size() || a_Sparse[id] != i || a_Allocator.m_EntityIndices[id] == npos ||
+                id >= a_Signatures.size() || !a_Signatures[id].test(a_Component))
+                throw std::runtime_error("Scene pool blocks are inconsistent");
+        }
+
+        uint32_t signatureCount = 0;
+        for (const Signature& signature : a_Signatures)
+            signatureCount += signature.test(a_Component) ? 1 : 0;
+        if (signatureCount != a_Entities.size())
+            throw std::runtime_error("Scene pool blocks are inconsistent");
+    }
+}
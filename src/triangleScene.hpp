@@ -0,0 +1,253 @@
+#pragma once
+
+#include "triangleECS.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace triangle
+{
+	// Read-only view of a whole file, mapped with mmap / MapViewOfFile
+	class MappedFile
+	{
+	public:
+		explicit MappedFile(const std::string& a_Path);
+		~MappedFile();
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		const std::byte* data() const { return m_Data; }
+		size_t size() const { return m_Size; }
+
+	private:
+		const std::byte* m_Data = nullptr;
+		size_t m_Size = 0;
+
+#ifdef _WIN32
+		void* m_File = nullptr;
+		void* m_Mapping = nullptr;
+#else
+		int m_Descriptor = -1;
+#endif
+	};
+
+	// Binary scene layout, all fields little endian:
+	//   SceneHeader
+	//   SceneBlock[blockCount]
+	//   block data, each block starting on a sceneBlockAlignment boundary
+	// Every block is a raw array copied straight out of (and back into) the
+	// ECS storage, so loading is a handful of block copies.
+	static constexpr char sceneMagic[8] = {'T', 'R', 'I', 'S', 'C', 'E', 'N', 'E'};
+	static constexpr uint32_t sceneVersion = 1;
+	static constexpr uint64_t sceneBlockAlignment = 64;
+
+	enum class SceneBlockKind : uint32_t
+	{
+		Generations,
+		EntityIndices,
+		Entities,
+		FreeList,
+		Signatures,
+		PoolSparse,
+		PoolEntities,
+		PoolComponents,
+		PoolChangeTicks
+	};
+
+	struct SceneHeader
+	{
+		char magic[8];
+		uint32_t version;
+		uint32_t blockCount;
+		uint32_t tick;
+		uint32_t componentCount;
+	};
+
+	struct SceneBlock
+	{
+		SceneBlockKind kind;
+		// Component id for pool blocks, npos otherwise
+		uint32_t component;
+		uint32_t elementSize;
+		uint32_t reserved;
+		uint64_t offset;
+		uint64_t count;
+	};
+
+	// Components stored as raw bytes: trivially copyable and assignable, which
+	// rules out types holding references (RenderModel). Pointers inside a
+	// stored component are written as is and are meaningless after loading.
+	template <typename T>
+	static constexpr bool isSceneStorable = std::is_trivially_copyable_v<T> && std::is_copy_assignable_v<T>;
+
+	// Saves and loads a whole ECS. Pools of components that are not
+	// isSceneStorable are left out and come back empty, with their signature
+	// bits cleared, for the caller to re-attach. Component ids and sizes must
+	// match between save and load.
+	class SceneSerializer
+	{
+	public:
+		template <typename... Components>
+		static void save(const ECS<Components...>& a_World, const std::string& a_Path)
+		{
+			const EntityAllocator& allocator = a_World.m_Allocator;
+
+			std::vector<BlockSource> blocks;
+			addBlock(blocks, SceneBlockKind::Generations, npos, allocator.m_Generations);
+			addBlock(blocks, SceneBlockKind::EntityIndices, npos, allocator.m_EntityIndices);
+			addBlock(blocks, SceneBlockKind::Entities, npos, allocator.m_Entities);
+			addBlock(blocks, SceneBlockKind::FreeList, npos, allocator.m_FreeList);
+			addBlock(blocks, SceneBlockKind::Signatures, npos, a_World.m_Signatures);
+
+			(addPoolBlocks(blocks, a_World.template componentID<Components>(), std::get<ComponentPool<Components>>(a_World.m_Pools)), ...);
+
+			write(a_Path, a_World.m_Tick, sizeof...(Components), blocks);
+		}
+
+		// Replaces a_World with the scene. Throws std::runtime_error if the file
+		// is not a scene of this version, does not match the component types or
+		// its entity and pool blocks do not describe a consistent world.
+		template <typename... Components>
+		static void load(ECS<Components...>& a_World, const std::string& a_Path)
+		{
+			MappedFile file(a_Path);
+			SceneHeader header;
+			std::vector<SceneBlock> blocks = readTable(file, header);
+
+			if (header.componentCount != sizeof...(Components))
+				throw std::runtime_error("Scene was saved with a different component set");
+
+			ECS<Components...> world;
+			world.m_Tick = header.tick;
+
+			EntityAllocator& allocator = world.m_Allocator;
+			assign(allocator.m_Generations, getBlock<uint32_t>(file, blocks, SceneBlockKind::Generations, npos, true));
+			assign(allocator.m_EntityIndices, getBlock<uint32_t>(file, blocks, SceneBlockKind::EntityIndices, npos, true));
+			assign(allocator.m_Entities, getBlock<Entity>(file, blocks, SceneBlockKind::Entities, npos, true));
+			assign(allocator.m_FreeList, getBlock<EntityID>(file, blocks, SceneBlockKind::FreeList, npos, true));
+			assign(world.m_Signatures, getBlock<Signature>(file, blocks, SceneBlockKind::Signatures, npos, true));
+
+			validateEntities(allocator, world.m_Signatures);
+
+			// A world that never created an entity stores no signatures, every
+			// id below the generation count needs one
+			world.m_Signatures.resize(allocator.m_Generations.size());
+
+			Signature loaded;
+			(loadPool(file, blocks, world.template componentID<Components>(), std::get<ComponentPool<Components>>(world.m_Pools),
+				allocator, world.m_Signatures, loaded), ...);
+
+			// Components that were not stored are dropped from the signatures
+			if (!loaded.all())
+			{
+				for (auto& signature : world.m_Signatures)
+					signature &= loaded;
+			}
+
+			a_World = std::move(world);
+		}
+
+	private:
+		struct BlockSource
+		{
+			SceneBlock block;
+			const void* data;
+		};
+
+		static void write(const std::string& a_Path, uint32_t a_Tick, uint32_t a_ComponentCount, std::vector<BlockSource>& a_Blocks);
+
+		// Validates the header and that every block lies inside the file
+		static std::vector<SceneBlock> readTable(const MappedFile& a_File, SceneHeader& a_Header);
+
+		// Every live entity maps back to its slot, ids are below the generation
+		// count and the free list holds each dead id exactly once
+		static void validateEntities(const EntityAllocator& a_Allocator, const std::vector<Signature>& a_Signatures);
+
+		// Sparse and dense arrays are inverse of each other over live entities,
+		// and the pool holds exactly the entities whose signature has a_Component
+		static void validatePool(std::span<const uint32_t> a_Sparse, std::span<const EntityID> a_Entities,
+			const EntityAllocator& a_Allocator, const std::vector<Signature>& a_Signatures, ComponentID a_Component);
+
+		template <typename T>
+		static void addBlock(std::vector<BlockSource>& a_Blocks, SceneBlockKind a_Kind, uint32_t a_Component, const std::vector<T>& a_Values)
+		{
+			static_assert(std::is_trivially_copyable_v<T>, "scene blocks are raw copies");
+			a_Blocks.push_back(BlockSource{SceneBlock{a_Kind, a_Component, sizeof(T), 0, 0, a_Values.size()}, a_Values.data()});
+		}
+
+		template <typename T>
+		static void addPoolBlocks(std::vector<BlockSource>& a_Blocks, ComponentID a_Component, const ComponentPool<T>& a_Pool)
+		{
+			if constexpr (isSceneStorable<T>)
+			{
+				addBlock(a_Blocks, SceneBlockKind::PoolSparse, a_Component, a_Pool.m_Sparse);
+				addBlock(a_Blocks, SceneBlockKind::PoolEntities, a_Component, a_Pool.m_Entities);
+				addBlock(a_Blocks, SceneBlockKind::PoolComponents, a_Component, a_Pool.m_Components);
+				addBlock(a_Blocks, SceneBlockKind::PoolChangeTicks, a_Component, a_Pool.m_ChangeTicks);
+			}
+		}
+
+		// The mapping is page aligned and blocks start on 64 byte boundaries,
+		// so the data can be viewed in place
+		template <typename T>
+		static std::span<const T> getBlock(const MappedFile& a_File, const std::vector<SceneBlock>& a_Blocks,
+			SceneBlockKind a_Kind, uint32_t a_Component, bool a_Required)
+		{
+			static_assert(alignof(T) <= sceneBlockAlignment);
+
+			for (const auto& block : a_Blocks)
+			{
+				if (block.kind != a_Kind || block.component != a_Component)
+					continue;
+
+				if (block.elementSize != sizeof(T))
+					throw std::runtime_error("Scene block element size does not match");
+
+				return std::span<const T>(reinterpret_cast<const T*>(a_File.data() + block.offset), block.count);
+			}
+
+			if (a_Required)
+				throw std::runtime_error("Scene is missing a required block");
+
+			return {};
+		}
+
+		// One block copy, no per-element work for trivially copyable T
+		template <typename T>
+		static void assign(std::vector<T>& a_Values, std::span<const T> a_Block)
+		{
+			a_Values.assign(a_Block.begin(), a_Block.end());
+		}
+
+		template <typename T>
+		static void loadPool(const MappedFile& a_File, const std::vector<SceneBlock>& a_Blocks, ComponentID a_Component,
+			ComponentPool<T>& a_Pool, const EntityAllocator& a_Allocator, const std::vector<Signature>& a_Signatures, Signature& a_Loaded)
+		{
+			if constexpr (isSceneStorable<T>)
+			{
+				auto components = getBlock<T>(a_File, a_Blocks, SceneBlockKind::PoolComponents, a_Component, false);
+				auto entities = getBlock<EntityID>(a_File, a_Blocks, SceneBlockKind::PoolEntities, a_Component, false);
+				auto ticks = getBlock<uint32_t>(a_File, a_Blocks, SceneBlockKind::PoolChangeTicks, a_Component, false);
+				auto sparse = getBlock<uint32_t>(a_File, a_Blocks, SceneBlockKind::PoolSparse, a_Component, false);
+
+				if (entities.size() != components.size() || ticks.size() != components.size())
+					throw std::runtime_error("Scene pool blocks are inconsistent");
+
+				validatePool(sparse, entities, a_Allocator, a_Signatures, a_Component);
+
+				assign(a_Pool.m_Sparse, sparse);
+				assign(a_Pool.m_Entities, entities);
+				assign(a_Pool.m_Components, components);
+				assign(a_Pool.m_ChangeTicks, ticks);
+
+				a_Loaded.set(a_Component);
+			}
+		}
+	};
+}
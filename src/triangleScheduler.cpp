@@ -0,0 +1,90 @@
+#include "triangleScheduler.hpp"
+
+namespace triangle
+{
+    Scheduler::Scheduler(JobSystem& jobSystem) : jobSystem{jobSystem} {}
+
+    void Scheduler::addSystem(const std::string& name, const Signature& reads, const Signature& writes, SystemFunction function)
+    {
+        systems.push_back(System{name, reads, writes, std::move(function), {}, 0});
+        graphDirty = true;
+    }
+
+    void Scheduler::buildGraph()
+    {
+        for (auto& system : systems)
+        {
+            system.successors.clear();
+            system.predecessorCount = 0;
+        }
+
+        for (uint32_t i = 0; i < systems.size(); ++i)
+        {
+            for (uint32_t j = i + 1; j < systems.size(); ++j)
+            {
+                bool conflict = (systems[i].writes & (systems[j].reads | systems[j].writes)).any() ||
+                                (systems[j].writes & systems[i].reads).any();
+
+                if (conflict)
+                {
+                    systems[i].successors.push_back(j);
+                    systems[j].predecessorCount++;
+                }
+            }
+        }
+
+        pendingPredecessors = std::vector<std::atomic<uint32_t>>(systems.size());
+        graphDirty = false;
+    }
+
+    void Scheduler::run()
+    {
+        if (systems.empty())
+            return;
+
+        if (graphDirty)
+            buildGraph();
+
+        for (uint32_t i = 0; i < systems.size(); ++i)
+            pendingPredecessors[i].store(systems[i].predecessorCount, std::memory_order_relaxed);
+
+        firstException = nullptr;
+
+        JobSystem::Counter counter;
+        for (uint32_t i = 0; i < systems.size(); ++i)
+        {
+            if (systems[i].predecessorCount == 0)
+                submitSystem(i, counter);
+        }
+
+        jobSystem.wait(counter);
+
+        if (firstException)
+            std::rethrow_exception(firstException);
+    }
+
+    void Scheduler::submitSystem(uint32_t index, JobSystem::Counter& counter)
+    {
+        jobSystem.submit([this, index, &counter]
+        {
+            try
+            {
+                systems[index].function();
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(exceptionMutex);
+                if (!firstException)
+                    firstException = std::current_exception();
+            }
+
+            // Submitted before this job's own count is released, so the
+            // counter cannot reach zero while successors are still pending
+            for (uint32_t successor : systems[index].successors)
+            {
+                if (pendingPredecessors[successor].fetch_sub(1, std::memory_order_acq_rel) == 1)
+                    submitSystem(successor, counter);
+            }
+        }, counter);
+    }
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "triangleECS.hpp"
+#include "triangleJobSystem.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace triangle
+{
+    // Runs registered systems once per run() call. Each system declares the
+    // components it reads and writes; two systems conflict when one writes a
+    // component the other touches, and conflicting systems keep their
+    // registration order. Everything else runs concurrently on the job system.
+    class Scheduler
+    {
+    public:
+        using SystemFunction = std::function<void()>;
+
+        Scheduler(JobSystem& jobSystem);
+
+        void addSystem(const std::string& name, const Signature& reads, const Signature& writes, SystemFunction function);
+
+        // Bit standing for shared state that is not a component (a camera, a
+        // tick counter, ...), or-ed into reads / writes like a component.
+        // Resources count down from the top of Signature, clear of the ids
+        // World hands out from the bottom; an index reaching them throws.
+        template <typename World>
+        static Signature resource(uint32_t index)
+        {
+            if (index >= maxComponents - World::Registry::count)
+                throw std::out_of_range("Scheduler resource " + std::to_string(index) + " collides with a component id");
+
+            Signature signature;
+            signature.set(maxComponents - 1 - index);
+            return signature;
+        }
+
+        // Blocks until every system has finished, the calling thread runs
+        // jobs while it waits. Rethrows the first exception thrown by a system.
+        void run();
+
+    private:
+        struct System
+        {
+            std::string name;
+            Signature reads, writes;
+            SystemFunction function;
+
+            std::vector<uint32_t> successors;
+            uint32_t predecessorCount = 0;
+        };
+
+        JobSystem& jobSystem;
+
+        std::vector<System> systems;
+        std::vector<std::atomic<uint32_t>> pendingPredecessors;
+        bool graphDirty = false;
+
+        std::mutex exceptionMutex;
+        std::exception_ptr firstException;
+
+        void buildGraph();
+        void submitSystem(uint32_t index, JobSystem::Counter& counter);
+    };
+}
@@ -0,0 +1,253 @@
+#include "triangleTransformKernels.hpp"
+
+#include <algorithm>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+    #define TRIANGLE_X86_SIMD 1
+    #include <immintrin.h>
+#else
+    #define TRIANGLE_X86_SIMD 0
+#endif
+
+namespace triangle
+{
+    namespace
+    {
+        // The matrices are written as raw column-major floats
+        static_assert(sizeof(glm::mat4) == 16 * sizeof(float), "glm::mat4 is expected to be 16 packed floats");
+
+        SimdLevel detectSimdLevel()
+        {
+#if TRIANGLE_X86_SIMD
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+                return SimdLevel::AVX2;
+            if (__builtin_cpu_supports("sse4.1"))
+                return SimdLevel::SSE41;
+#endif
+            return SimdLevel::Scalar;
+        }
+
+        void composeScalar(const TransformSoA& t, const float* viewProj, uint32_t begin, uint32_t end, float* models, float* mvps)
+        {
+            for (uint32_t i = begin; i < end; ++i)
+            {
+                float x = t.rotationX[i], y = t.rotationY[i], z = t.rotationZ[i], w = t.rotationW[i];
+                float sx = t.scaleX[i], sy = t.scaleY[i], sz = t.scaleZ[i];
+
+                float xx = x * x, yy = y * y, zz = z * z;
+                float xy = x * y, xz = x * z, yz = y * z;
+                float wx = w * x, wy = w * y, wz = w * z;
+
+                float m[16] = {
+                    (1.f - 2.f * (yy + zz)) * sx, 2.f * (xy + wz) * sx, 2.f * (xz - wy) * sx, 0.f,
+                    2.f * (xy - wz) * sy, (1.f - 2.f * (xx + zz)) * sy, 2.f * (yz + wx) * sy, 0.f,
+                    2.f * (xz + wy) * sz, 2.f * (yz - wx) * sz, (1.f - 2.f * (xx + yy)) * sz, 0.f,
+                    t.positionX[i], t.positionY[i], t.positionZ[i], 1.f};
+
+                std::copy(m, m + 16, models + i * 16);
+
+                if (!viewProj)
+                    continue;
+
+                for (uint32_t c = 0; c < 4; ++c)
+                {
+                    for (uint32_t r = 0; r < 4; ++r)
+                    {
+                        mvps[i * 16 + c * 4 + r] = viewProj[r] * m[c * 4] + viewProj[4 + r] * m[c * 4 + 1] +
+                                                   viewProj[8 + r] * m[c * 4 + 2] + viewProj[12 + r] * m[c * 4 + 3];
+                    }
+                }
+            }
+        }
+
+#if TRIANGLE_X86_SIMD
+        // Each register holds one matrix element for 4 entities, transposed so
+        // every entity gets its column written with a single store.
+        __attribute__((target("sse4.1")))
+        void storeColumnsSSE(float* out, uint32_t first, uint32_t column, __m128 r0, __m128 r1, __m128 r2, __m128 r3)
+        {
+            _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+            _mm_storeu_ps(out + (first + 0) * 16 + column * 4, r0);
+            _mm_storeu_ps(out + (first + 1) * 16 + column * 4, r1);
+            _mm_storeu_ps(out + (first + 2) * 16 + column * 4, r2);
+            _mm_storeu_ps(out + (first + 3) * 16 + column * 4, r3);
+        }
+
+        __attribute__((target("sse4.1")))
+        void composeSSE41(const TransformSoA& t, const float* viewProj, uint32_t begin, uint32_t end, float* models, float* mvps)
+        {
+            const __m128 one = _mm_set1_ps(1.f), two = _mm_set1_ps(2.f), zero = _mm_setzero_ps();
+
+            uint32_t i = begin;
+            for (; i + 4 <= end; i += 4)
+            {
+                __m128 x = _mm_loadu_ps(&t.rotationX[i]), y = _mm_loadu_ps(&t.rotationY[i]);
+                __m128 z = _mm_loadu_ps(&t.rotationZ[i]), w = _mm_loadu_ps(&t.rotationW[i]);
+                __m128 sx = _mm_loadu_ps(&t.scaleX[i]), sy = _mm_loadu_ps(&t.scaleY[i]), sz = _mm_loadu_ps(&t.scaleZ[i]);
+
+                __m128 xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y), zz = _mm_mul_ps(z, z);
+                __m128 xy = _mm_mul_ps(x, y), xz = _mm_mul_ps(x, z), yz = _mm_mul_ps(y, z);
+                __m128 wx = _mm_mul_ps(w, x), wy = _mm_mul_ps(w, y), wz = _mm_mul_ps(w, z);
+
+                // m[column][row]
+                __m128 m[4][4] = {
+                    {_mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), sx),
+                     _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, wz)), sx),
+                     _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, wy)), sx),
+                     zero},
+                    {_mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, wz)), sy),
+                     _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), sy),
+                     _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, wx)), sy),
+                     zero},
+                    {_mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, wy)), sz),
+                     _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, wx)), sz),
+                     _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), sz),
+                     zero},
+                    {_mm_loadu_ps(&t.positionX[i]), _mm_loadu_ps(&t.positionY[i]), _mm_loadu_ps(&t.positionZ[i]), one}};
+
+                for (uint32_t c = 0; c < 4; ++c)
+                    storeColumnsSSE(models, i, c, m[c][0], m[c][1], m[c][2], m[c][3]);
+
+                if (!viewProj)
+                    continue;
+
+                for (uint32_t c = 0; c < 4; ++c)
+                {
+                    __m128 mvp[4];
+                    for (uint32_t r = 0; r < 4; ++r)
+                    {
+                        __m128 sum = _mm_mul_ps(_mm_set1_ps(viewProj[r]), m[c][0]);
+                        sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(viewProj[4 + r]), m[c][1]));
+                        sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(viewProj[8 + r]), m[c][2]));
+                        mvp[r] = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(viewProj[12 + r]), m[c][3]));
+                    }
+                    storeColumnsSSE(mvps, i, c, mvp[0], mvp[1], mvp[2], mvp[3]);
+                }
+            }
+
+            composeScalar(t, viewProj, i, end, models, mvps);
+        }
+
+        // 8 entities per register, the in-lane transpose leaves entities
+        // 0-3 in the low halves and 4-7 in the high halves.
+        __attribute__((target("avx2,fma")))
+        void storeColumnsAVX2(float* out, uint32_t first, uint32_t column, __m256 r0, __m256 r1, __m256 r2, __m256 r3)
+        {
+            __m256 t0 = _mm256_unpacklo_ps(r0, r1), t1 = _mm256_unpackhi_ps(r0, r1);
+            __m256 t2 = _mm256_unpacklo_ps(r2, r3), t3 = _mm256_unpackhi_ps(r2, r3);
+
+            __m256 columns[4] = {
+                _mm256_shuffle_ps(t0, t2, 0x44), _mm256_shuffle_ps(t0, t2, 0xEE),
+                _mm256_shuffle_ps(t1, t3, 0x44), _mm256_shuffle_ps(t1, t3, 0xEE)};
+
+            for (uint32_t k = 0; k < 4; ++k)
+            {
+                _mm_storeu_ps(out + (first + k) * 16 + column * 4, _mm256_castps256_ps128(columns[k]));
+                _mm_storeu_ps(out + (first + k + 4) * 16 + column * 4, _mm256_extractf128_ps(columns[k], 1));
+            }
+        }
+
+        __attribute__((target("avx2,fma")))
+        void composeAVX2(const TransformSoA& t, const float* viewProj, uint32_t begin, uint32_t end, float* models, float* mvps)
+        {
+            const __m256 one = _mm256_set1_ps(1.f), two = _mm256_set1_ps(2.f), zero = _mm256_setzero_ps();
+
+            uint32_t i = begin;
+            for (; i + 8 <= end; i += 8)
+            {
+                __m256 x = _mm256_loadu_ps(&t.rotationX[i]), y = _mm256_loadu_ps(&t.rotationY[i]);
+                __m256 z = _mm256_loadu_ps(&t.rotationZ[i]), w = _mm256_loadu_ps(&t.rotationW[i]);
+                __m256 sx = _mm256_loadu_ps(&t.scaleX[i]), sy = _mm256_loadu_ps(&t.scaleY[i]), sz = _mm256_loadu_ps(&t.scaleZ[i]);
+
+                __m256 xx = _mm256_mul_ps(x, x), yy = _mm256_mul_ps(y, y), zz = _mm256_mul_ps(z, z);
+                __m256 xy = _mm256_mul_ps(x, y), xz = _mm256_mul_ps(x, z), yz = _mm256_mul_ps(y, z);
+                __m256 wx = _mm256_mul_ps(w, x), wy = _mm256_mul_ps(w, y), wz = _mm256_mul_ps(w, z);
+
+                // m[column][row], 1 - 2a computed as fnmadd(2, a, 1)
+                __m256 m[4][4] = {
+                    {_mm256_mul_ps(_mm256_fnmadd_ps(two, _mm256_add_ps(yy, zz), one), sx),
+                     _mm256_mul_ps(_mm256_mul_ps(two, _mm256_add_ps(xy, wz)), sx),
+                     _mm256_mul_ps(_mm256_mul_ps(two, _mm256_sub_ps(xz, wy)), sx),
+                     zero},
+                    {_mm256_mul_ps(_mm256_mul_ps(two, _mm256_sub_ps(xy, wz)), sy),
+                     _mm256_mul_ps(_mm256_fnmadd_ps(two, _mm256_add_ps(xx, zz), one), sy),
+                     _mm256_mul_ps(_mm256_mul_ps(two, _mm256_add_ps(yz, wx)), sy),
+                     zero},
+                    {_mm256_mul_ps(_mm256_mul_ps(two, _mm256_add_ps(xz, wy)), sz),
+                     _mm256_mul_ps(_mm256_mul_ps(two, _mm256_sub_ps(yz, wx)), sz),
+                     _mm256_mul_ps(_mm256_fnmadd_ps(two, _mm256_add_ps(xx, yy), one), sz),
+                     zero},
+                    {_mm256_loadu_ps(&t.positionX[i]), _mm256_loadu_ps(&t.positionY[i]), _mm256_loadu_ps(&t.positionZ[i]), one}};
+
+                for (uint32_t c = 0; c < 4; ++c)
+                    storeColumnsAVX2(models, i, c, m[c][0], m[c][1], m[c][2], m[c][3]);
+
+                if (!viewProj)
+                    continue;
+
+                for (uint32_t c = 0; c < 4; ++c)
+                {
+                    __m256 mvp[4];
+                    for (uint32_t r = 0; r < 4; ++r)
+                    {
+                        __m256 sum = _mm256_mul_ps(_mm256_set1_ps(viewProj[r]), m[c][0]);
+                        sum = _mm256_fmadd_ps(_mm256_set1_ps(viewProj[4 + r]), m[c][1], sum);
+                        sum = _mm256_fmadd_ps(_mm256_set1_ps(viewProj[8 + r]), m[c][2], sum);
+                        mvp[r] = _mm256_fmadd_ps(_mm256_set1_ps(viewProj[12 + r]), m[c][3], sum);
+                    }
+                    storeColumnsAVX2(mvps, i, c, mvp[0], mvp[1], mvp[2], mvp[3]);
+                }
+            }
+
+            composeSSE41(t, viewProj, i, end, models, mvps);
+        }
+#endif
+
+        void compose(const TransformSoA& t, const float* viewProj, uint32_t begin, uint32_t end, float* models, float* mvps, SimdLevel level)
+        {
+            level = std::min(level, getSimdLevel());
+            end = std::min(end, t.size());
+            if (begin >= end)
+                return;
+
+#if TRIANGLE_X86_SIMD
+            if (level == SimdLevel::AVX2)
+                return composeAVX2(t, viewProj, begin, end, models, mvps);
+            if (level == SimdLevel::SSE41)
+                return composeSSE41(t, viewProj, begin, end, models, mvps);
+#endif
+            composeScalar(t, viewProj, begin, end, models, mvps);
+        }
+    }
+
+    SimdLevel getSimdLevel()
+    {
+        static const SimdLevel level = detectSimdLevel();
+        return level;
+    }
+
+    const char* getSimdLevelName(SimdLevel level)
+    {
+        switch (level)
+        {
+        case SimdLevel::AVX2:
+            return "AVX2";
+        case SimdLevel::SSE41:
+            return "SSE4.1";
+        default:
+            return "scalar";
+        }
+    }
+
+    void composeModelMatrices(const TransformSoA& transforms, uint32_t begin, uint32_t end, glm::mat4* models, SimdLevel level)
+    {
+        compose(transforms, nullptr, begin, end, &models[0][0][0], nullptr, level);
+    }
+
+    void composeMVPMatrices(const TransformSoA& transforms, const glm::mat4& viewProj, uint32_t begin, uint32_t end,
+                            glm::mat4* models, glm::mat4* mvps, SimdLevel level)
+    {
+        compose(transforms, &viewProj[0][0], begin, end, &models[0][0][0], &mvps[0][0][0], level);
+    }
+}
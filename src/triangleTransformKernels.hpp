@@ -0,0 +1,67 @@
+#pragma once
+
+#include "triangleTypes.hpp"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <cstdint>
+#include <vector>
+
+namespace triangle
+{
+    enum class SimdLevel : uint32_t
+    {
+        Scalar,
+        SSE41,
+        AVX2
+    };
+
+    // Best level supported by the running CPU, detected once
+    SimdLevel getSimdLevel();
+    const char* getSimdLevelName(SimdLevel level);
+
+    // Transforms laid out one array per component so the kernels below can
+    // load several entities per register. Rotations are stored as quaternions,
+    // the euler to quaternion conversion happens once in push_back().
+    struct TransformSoA
+    {
+        std::vector<float> positionX, positionY, positionZ;
+        std::vector<float> rotationX, rotationY, rotationZ, rotationW;
+        std::vector<float> scaleX, scaleY, scaleZ;
+
+        uint32_t size() const { return static_cast<uint32_t>(positionX.size()); }
+
+        void clear()
+        {
+            for (auto* values : {&positionX, &positionY, &positionZ, &rotationX, &rotationY, &rotationZ, &rotationW, &scaleX, &scaleY, &scaleZ})
+                values->clear();
+        }
+
+        void push_back(const Transform& transform)
+        {
+            glm::quat rotation(transform.rotation);
+
+            positionX.push_back(transform.position.x);
+            positionY.push_back(transform.position.y);
+            positionZ.push_back(transform.position.z);
+            rotationX.push_back(rotation.x);
+            rotationY.push_back(rotation.y);
+            rotationZ.push_back(rotation.z);
+            rotationW.push_back(rotation.w);
+            scaleX.push_back(transform.scale.x);
+            scaleY.push_back(transform.scale.y);
+            scaleZ.push_back(transform.scale.z);
+        }
+    };
+
+    // models[i] = translate * rotate * scale for every i in [begin, end).
+    // Output arrays are indexed like the batch. A level above getSimdLevel()
+    // falls back to the best supported one.
+    void composeModelMatrices(const TransformSoA& transforms, uint32_t begin, uint32_t end,
+                              glm::mat4* models, SimdLevel level = getSimdLevel());
+
+    // Same, and also mvps[i] = viewProj * models[i]
+    void composeMVPMatrices(const TransformSoA& transforms, const glm::mat4& viewProj, uint32_t begin, uint32_t end,
+                            glm::mat4* models, glm::mat4* mvps, SimdLevel level = getSimdLevel());
+}
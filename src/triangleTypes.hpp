@@ -1,19 +1,24 @@
 #pragma once
 
 #include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
 #include <vulkan/vulkan.hpp>
 
+#include <array>
+#include <atomic>
 #include <vector>
 
 namespace triangle
 {
 	using Index = uint32_t;
 
-	struct MVP
+	// Written once per frame into binding 0, shared by every draw
+	struct CameraData
 	{
-		glm::mat4 model;
 		glm::mat4 view;
 		glm::mat4 proj;
+		glm::mat4 viewProj;
 	};
 
 	struct Vertex
@@ -23,25 +28,85 @@ namespace triangle
 		// glm::vec3 normal;
 		glm::vec2 uv;
 
-		// Initialized in triangleModel.cpp
+		// Initialized in triangleModel.cpp. Binding 0 holds the vertices.
 		static std::vector<vk::VertexInputBindingDescription> getBindingDesciptions();
 		static std::vector<vk::VertexInputAttributeDescription> getAttributeDescriptions();
 	};
 
+	// Per-object data in the storage buffer at descriptor binding 2, at the
+	// slot of the entity (id - 1). The storage buffer at binding 3 holds one
+	// uint32_t slot per drawn instance, read by the vertex shaders at
+	// gl_InstanceIndex.
+	struct ObjectData
+	{
+		glm::mat4 model;
+	};
+
+	// std430 stride of ObjectBuffer.models in the vertex shaders
+	static_assert(sizeof(ObjectData) == 64, "ObjectData must match ObjectBuffer in the vertex shaders");
+
 	struct Mesh
 	{
 		std::vector<Vertex> vertices;
 		std::vector<Index> indices;
-		MVP mvp;
 
-		Mesh(std::vector<Vertex> &a_Vertices, std::vector<Index> &a_Indices) : vertices{a_Vertices}, indices{a_Indices} {};
+		// Never reused, unlike the address of a destroyed Mesh, so uploaded
+		// geometry is keyed by it. Copies hold the same geometry and share it.
+		uint32_t id;
+
+		Mesh(std::vector<Vertex> &a_Vertices, std::vector<Index> &a_Indices) : vertices{a_Vertices}, indices{a_Indices}, id{nextID()} {};
+
+	private:
+		static uint32_t nextID()
+		{
+			static std::atomic<uint32_t> counter = 0;
+			return counter++;
+		}
 	};
 
+	// Relative to the parent in the TransformHierarchy, rotation is in
+	// radians (pitch, yaw, roll)
 	struct Transform
 	{
 		glm::vec3 position = glm::vec3(0.f, 0.f, 0.f);
 		glm::vec3 rotation = glm::vec3(0.f, 0.f, 0.f);
-		glm::vec3 scale = glm::vec3(0.f, 0.f, 0.f);
+		glm::vec3 scale = glm::vec3(1.f, 1.f, 1.f);
+
+		glm::mat4 getMatrix() const
+		{
+			return glm::scale(glm::translate(glm::mat4{1.0f}, position) * glm::mat4_cast(glm::quat(rotation)), scale);
+		}
+	};
+
+	// Planes of a view frustum as (normal, distance), normals point inwards
+	// and are normalized. Order: left, right, bottom, top, near, far.
+	struct Frustum
+	{
+		std::array<glm::vec4, 6> planes;
+
+		// Expects Vulkan clip space, depth in [0, 1]
+		static Frustum fromMatrix(const glm::mat4& a_ViewProj)
+		{
+			auto row = [&](int i) { return glm::vec4(a_ViewProj[0][i], a_ViewProj[1][i], a_ViewProj[2][i], a_ViewProj[3][i]); };
+
+			Frustum frustum;
+			frustum.planes = {row(3) + row(0), row(3) - row(0), row(3) + row(1), row(3) - row(1), row(2), row(3) - row(2)};
+
+			for (auto& plane : frustum.planes)
+				plane /= glm::length(glm::vec3(plane));
+
+			return frustum;
+		}
+
+		bool intersectsSphere(const glm::vec3& a_Center, float a_Radius) const
+		{
+			for (const auto& plane : planes)
+			{
+				if (glm::dot(glm::vec3(plane), a_Center) + plane.w < -a_Radius)
+					return false;
+			}
+			return true;
+		}
 	};
 
 	struct Material
@@ -53,11 +118,10 @@ namespace triangle
 	struct RenderModel
 	{
 		Mesh &mesh;
-		Transform &transform;
 		Material &material;
 
-		RenderModel(Mesh& a_Mesh, Transform& a_Transform, Material& a_Material) 
-			: mesh{a_Mesh}, transform{a_Transform}, material{a_Material} {};
+		RenderModel(Mesh& a_Mesh, Material& a_Material) 
+			: mesh{a_Mesh}, material{a_Material} {};
 	};
 
 	struct MeshPushConstant
@@ -0,0 +1,107 @@
+// Compares the SSE4.1 and AVX2 frustum culling kernels with the scalar one
+// on random spheres. Range lengths and starts cover every tail, which the
+// wide kernels hand down to the narrower ones.
+
+#include "../src/triangleCullingKernels.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+namespace
+{
+    using namespace triangle;
+
+    int failures = 0;
+
+    void check(bool a_Condition, const char* a_What)
+    {
+        if (a_Condition)
+            return;
+
+        std::fprintf(stderr, "FAILED: %s\n", a_What);
+        ++failures;
+    }
+
+    // Closest any plane gets to deciding the sphere, in double precision.
+    // The kernels sum the plane equation in different orders, FMA included,
+    // so spheres closer than float rounding may legitimately disagree.
+    double margin(const Frustum& a_Frustum, float a_X, float a_Y, float a_Z, float a_Radius)
+    {
+        double closest = HUGE_VAL;
+        for (const auto& plane : a_Frustum.planes)
+        {
+            double distance = double(plane.x) * a_X + double(plane.y) * a_Y + double(plane.z) * a_Z + plane.w;
+            closest = std::min(closest, std::abs(distance + a_Radius));
+        }
+        return closest;
+    }
+
+    BoundsSoA randomSpheres(const Frustum& a_Frustum, uint32_t a_Count, std::mt19937& a_Random)
+    {
+        std::uniform_real_distribution<float> position{-30.f, 30.f}, radius{0.f, 4.f};
+
+        BoundsSoA bounds;
+        while (bounds.size() < a_Count)
+        {
+            float x = position(a_Random), y = position(a_Random), z = position(a_Random), r = radius(a_Random);
+            if (margin(a_Frustum, x, y, z, r) < 1.0e-3)
+                continue;
+
+            bounds.push_back(glm::translate(glm::mat4(1.f), glm::vec3(x, y, z)), glm::vec4(0.f, 0.f, 0.f, r));
+        }
+        return bounds;
+    }
+
+    // Entries outside [begin, end) must keep this value
+    constexpr uint8_t untouched = 0xAB;
+
+    void compareRange(const BoundsSoA& a_Bounds, const Frustum& a_Frustum, uint32_t a_Begin, uint32_t a_End, SimdLevel a_Level)
+    {
+        std::vector<uint8_t> expected(a_Bounds.size(), untouched), visible(a_Bounds.size(), untouched);
+        uint32_t expectedCount = cullSpheres(a_Bounds, a_Frustum, a_Begin, a_End, expected.data(), SimdLevel::Scalar);
+        uint32_t count = cullSpheres(a_Bounds, a_Frustum, a_Begin, a_End, visible.data(), a_Level);
+
+        check(visible == expected, "wide kernel flags the same spheres as the scalar one");
+        check(count == expectedCount, "wide kernel counts the same visible spheres as the scalar one");
+    }
+}
+
+int main()
+{
+    std::mt19937 random{7};
+
+    glm::mat4 view = glm::translate(glm::mat4(1.f), glm::vec3(0.f, 0.f, -10.f));
+    glm::mat4 proj = glm::perspective(0.8f, 16.f / 9.f, 0.1f, 30.f);
+    Frustum frustum = Frustum::fromMatrix(proj * view);
+
+    BoundsSoA bounds = randomSpheres(frustum, 1027, random);
+
+    std::vector<uint8_t> visible(bounds.size());
+    uint32_t visibleCount = cullSpheres(bounds, frustum, 0, bounds.size(), visible.data(), SimdLevel::Scalar);
+    check(visibleCount > 0 && visibleCount < bounds.size(), "random spheres are partly visible");
+
+    // Levels above the CPU's are clamped by cullSpheres, those runs compare
+    // the scalar kernel with itself
+    std::printf("CPU supports: %s\n", getSimdLevelName(getSimdLevel()));
+    for (SimdLevel level : {SimdLevel::SSE41, SimdLevel::AVX2})
+    {
+        for (uint32_t begin = 0; begin < 9; ++begin)
+        {
+            for (uint32_t length = 0; length <= 40; ++length)
+                compareRange(bounds, frustum, begin, begin + length, level);
+        }
+
+        compareRange(bounds, frustum, 0, bounds.size(), level);
+        compareRange(bounds, frustum, 3, bounds.size(), level);
+    }
+
+    if (failures == 0)
+        std::printf("cull kernels: all checks passed, %u / %u spheres visible\n", visibleCount, bounds.size());
+
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,74 @@
+// Checks that every thread maps to the right worker index when several job
+// systems live side by side, which the per-thread command buffers rely on.
+
+#include "../src/triangleJobSystem.hpp"
+
+#include <atomic>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    using namespace triangle;
+
+    int failures = 0;
+
+    void check(bool a_Condition, const char* a_What)
+    {
+        if (a_Condition)
+            return;
+
+        std::fprintf(stderr, "FAILED: %s\n", a_What);
+        ++failures;
+    }
+
+    void testSecondJobSystemOnSameThread()
+    {
+        JobSystem first(4);
+        check(first.getCurrentWorkerIndex() == 0, "constructing thread is worker 0");
+
+        {
+            JobSystem second(2);
+            check(second.getCurrentWorkerIndex() == 0, "constructing thread is worker 0 of the second job system");
+            check(first.getCurrentWorkerIndex() == 0, "second job system does not take worker 0 of the first");
+        }
+
+        check(first.getCurrentWorkerIndex() == 0, "destroying the second job system keeps worker 0 of the first");
+
+        uint32_t foreignIndex = 0;
+        std::thread([&] { foreignIndex = first.getCurrentWorkerIndex(); }).join();
+        check(foreignIndex == first.getWorkerCount(), "threads outside the job system get getWorkerCount()");
+    }
+
+    // Jobs of one job system see themselves as foreign to the other one
+    void testNestedJobSystems()
+    {
+        JobSystem outer(3), inner(3);
+
+        std::vector<std::atomic<uint32_t>> hits(outer.getWorkerCount() + 1);
+        std::atomic<bool> innerIndexValid{true};
+        outer.parallelFor(256, 1, [&](uint32_t, uint32_t)
+        {
+            hits[outer.getCurrentWorkerIndex()].fetch_add(1);
+
+            uint32_t index = inner.getCurrentWorkerIndex();
+            if (index != 0 && index != inner.getWorkerCount())
+                innerIndexValid = false;
+        });
+
+        check(hits[outer.getWorkerCount()] == 0, "jobs always run on a worker of their job system");
+        check(innerIndexValid, "workers of one job system are foreign to another");
+    }
+}
+
+int main()
+{
+    testSecondJobSystemOnSameThread();
+    testNestedJobSystems();
+
+    if (failures == 0)
+        std::printf("job system: all checks passed\n");
+
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,278 @@
+// Saves a small world, loads it back and compares entities and every
+// component pool, then checks that truncated and corrupted files are
+// rejected instead of producing a world that indexes out of bounds.
+//
+// Usage: scene_serializer_test [<scratch file>]
+
+#include "../src/triangleECS.hpp"
+#include "../src/triangleScene.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace
+{
+    using namespace triangle;
+
+    struct Position
+    {
+        float x = 0.f, y = 0.f, z = 0.f;
+
+        bool operator==(const Position&) const = default;
+    };
+
+    struct Health
+    {
+        int value = 0;
+
+        bool operator==(const Health&) const = default;
+    };
+
+    using World = ECS<Position, Health>;
+
+    int failures = 0;
+
+    void check(bool a_Condition, const char* a_What)
+    {
+        if (a_Condition)
+            return;
+
+        std::fprintf(stderr, "FAILED: %s\n", a_What);
+        ++failures;
+    }
+
+    // Dense order of the pool, so a reordered or partial pool does not compare equal
+    template <typename T>
+    std::vector<std::pair<Entity, T>> poolContents(World& a_World)
+    {
+        std::vector<std::pair<Entity, T>> contents;
+        a_World.view<T>().each([&](Entity entity, T& component) { contents.emplace_back(entity, component); });
+        return contents;
+    }
+
+    // Live and dead ids, removed components and a recycled slot, so every
+    // block holds something
+    World buildWorld()
+    {
+        World world;
+        std::vector<Entity> entities;
+        for (int i = 0; i < 64; ++i)
+        {
+            Entity entity = world.addEntity();
+            world.assignComponent(entity, Position{float(i), float(i * 2), float(i * 3)});
+            if (i % 3 == 0)
+                world.assignComponent(entity, Health{i});
+            entities.push_back(entity);
+        }
+
+        // Highest id, without components
+        world.addEntity();
+
+        world.advanceTick();
+        for (int i = 0; i < 64; i += 5)
+            world.deleteEntity(entities[i]);
+        for (int i = 1; i < 64; i += 7)
+            world.deleteComponent<Position>(entities[i]);
+
+        world.markChanged<Position>(entities[2]);
+        world.assignComponent(world.addEntity(), Health{1000});
+
+        return world;
+    }
+
+    std::vector<char> readFile(const std::string& a_Path)
+    {
+        std::ifstream file(a_Path, std::ios::binary);
+        return std::vector<char>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+
+    void writeFile(const std::string& a_Path, const std::vector<char>& a_Bytes)
+    {
+        std::ofstream file(a_Path, std::ios::binary | std::ios::trunc);
+        file.write(a_Bytes.data(), static_cast<std::streamsize>(a_Bytes.size()));
+    }
+
+    bool loadThrows(const std::string& a_Path)
+    {
+        World world;
+        try
+        {
+            SceneSerializer::load(world, a_Path);
+        }
+        catch (const std::runtime_error&)
+        {
+            return true;
+        }
+        return false;
+    }
+
+    SceneBlock* findBlock(std::vector<char>& a_Bytes, SceneBlockKind a_Kind, uint32_t a_Component)
+    {
+        SceneHeader header;
+        std::memcpy(&header, a_Bytes.data(), sizeof(header));
+
+        auto* blocks = reinterpret_cast<SceneBlock*>(a_Bytes.data() + sizeof(SceneHeader));
+        for (uint32_t i = 0; i < header.blockCount; ++i)
+        {
+            if (blocks[i].kind == a_Kind && blocks[i].component == a_Component)
+                return &blocks[i];
+        }
+        return nullptr;
+    }
+
+    void testRoundTrip(const std::string& a_Path)
+    {
+        World saved = buildWorld();
+        SceneSerializer::save(saved, a_Path);
+
+        World loaded;
+        SceneSerializer::load(loaded, a_Path);
+
+        check(loaded.getTick() == saved.getTick(), "tick survives the round trip");
+        check(loaded.getEntitySlotCount() == saved.getEntitySlotCount(), "slot count survives the round trip");
+        check(loaded.getEntities() == saved.getEntities(), "live entities survive the round trip");
+
+        for (const Entity& entity : saved.getEntities())
+            check(loaded.getSignature(entity) == saved.getSignature(entity), "signatures survive the round trip");
+
+        check(poolContents<Position>(loaded) == poolContents<Position>(saved), "Position pool survives the round trip");
+        check(poolContents<Health>(loaded) == poolContents<Health>(saved), "Health pool survives the round trip");
+
+        uint32_t since = 1;
+        check(poolContents<Position>(loaded).size() > 0 &&
+            loaded.view<Position>().changed<Position>(since).size() == saved.view<Position>().changed<Position>(since).size(),
+            "change ticks survive the round trip");
+
+        // Freed ids come back in the same order
+        Entity savedNext = saved.addEntity(), loadedNext = loaded.addEntity();
+        check(savedNext == loadedNext, "free list survives the round trip");
+        check(loaded.assignComponent(loadedNext, Health{7}) && loaded.getComponent<Health>(loadedNext)->value == 7,
+            "loaded world accepts new components");
+    }
+
+    void testEmptyWorld(const std::string& a_Path)
+    {
+        World saved;
+        SceneSerializer::save(saved, a_Path);
+
+        World loaded;
+        SceneSerializer::load(loaded, a_Path);
+
+        check(loaded.getEntities().empty(), "empty world loads empty");
+
+        Entity entity = loaded.addEntity();
+        check(loaded.assignComponent(entity, Position{1.f, 2.f, 3.f}) && loaded.getSignature(entity).any(),
+            "entities can be added to a loaded empty world");
+    }
+
+    // Signatures only cover ids up to the last one that got a component,
+    // entities above it still need an (empty) signature after loading
+    void testShortSignatures(const std::string& a_Path)
+    {
+        World saved = buildWorld();
+        SceneSerializer::save(saved, a_Path);
+
+        std::vector<char> bytes = readFile(a_Path);
+        findBlock(bytes, SceneBlockKind::Signatures, npos)->count -= 1;
+        writeFile(a_Path, bytes);
+
+        World loaded;
+        SceneSerializer::load(loaded, a_Path);
+
+        auto highest = std::find_if(loaded.getEntities().begin(), loaded.getEntities().end(),
+            [&](const Entity& entity) { return entity.id == loaded.getEntitySlotCount(); });
+        check(highest != loaded.getEntities().end(), "highest id is alive");
+        if (highest == loaded.getEntities().end())
+            return;
+
+        Entity last = *highest;
+        check(loaded.getSignature(last).none(),
+            "entities past a short signatures block get an empty signature");
+        check(loaded.assignComponent(last, Health{3}) && loaded.getComponent<Health>(last)->value == 3,
+            "entities past a short signatures block accept components");
+    }
+
+    void testRejected(const std::string& a_Path, const char* a_What, const std::function<void(std::vector<char>&)>& a_Corrupt)
+    {
+        SceneSerializer::save(buildWorld(), a_Path);
+
+        std::vector<char> bytes = readFile(a_Path);
+        a_Corrupt(bytes);
+        writeFile(a_Path, bytes);
+
+        check(loadThrows(a_Path), a_What);
+    }
+
+    void testCorruptedFiles(const std::string& a_Path)
+    {
+        testRejected(a_Path, "truncated header is rejected", [](std::vector<char>& bytes) { bytes.resize(sizeof(SceneHeader) / 2); });
+        testRejected(a_Path, "truncated block table is rejected", [](std::vector<char>& bytes) { bytes.resize(sizeof(SceneHeader) + 4); });
+        testRejected(a_Path, "truncated block data is rejected", [](std::vector<char>& bytes) { bytes.resize(bytes.size() - 16); });
+        testRejected(a_Path, "wrong magic is rejected", [](std::vector<char>& bytes) { bytes[0] = 'X'; });
+
+        // Live entities above the signatures block would index past m_Signatures
+        testRejected(a_Path, "short signatures block is rejected", [](std::vector<char>& bytes)
+        {
+            findBlock(bytes, SceneBlockKind::Signatures, npos)->count = 1;
+        });
+
+        testRejected(a_Path, "long signatures block is rejected", [](std::vector<char>& bytes)
+        {
+            SceneBlock* generations = findBlock(bytes, SceneBlockKind::Generations, npos);
+            generations->count -= 1;
+        });
+
+        testRejected(a_Path, "entity outside the generations is rejected", [](std::vector<char>& bytes)
+        {
+            SceneBlock* block = findBlock(bytes, SceneBlockKind::Entities, npos);
+            auto* entities = reinterpret_cast<Entity*>(bytes.data() + block->offset);
+            entities[0].id = 100000;
+        });
+
+        testRejected(a_Path, "pool entry of a dead entity is rejected", [](std::vector<char>& bytes)
+        {
+            SceneBlock* block = findBlock(bytes, SceneBlockKind::PoolEntities, World::componentID<Position>());
+            auto* entities = reinterpret_cast<EntityID*>(bytes.data() + block->offset);
+            // Id 1 was deleted by buildWorld() and is on the free list
+            entities[0] = 1;
+        });
+
+        testRejected(a_Path, "pool block of the wrong element size is rejected", [](std::vector<char>& bytes)
+        {
+            findBlock(bytes, SceneBlockKind::PoolComponents, World::componentID<Health>())->elementSize = 8;
+        });
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::string path = argc > 1 ? argv[1] : "scene_serializer_test.scene";
+
+    try
+    {
+        testRoundTrip(path);
+        testEmptyWorld(path);
+        testShortSignatures(path);
+        testCorruptedFiles(path);
+    }
+    catch (const std::exception& error)
+    {
+        std::fprintf(stderr, "FAILED: unexpected exception: %s\n", error.what());
+        ++failures;
+    }
+
+    std::remove(path.c_str());
+
+    if (failures == 0)
+        std::printf("scene serializer: all checks passed\n");
+
+    return failures == 0 ? 0 : 1;
+}